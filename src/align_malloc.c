@@ -1,20 +1,156 @@
 #include <errno.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
 
 #include "align_malloc.h"
 
+#define CACHE_LINE      64
+#define HUGE_PAGE_SIZE  (2*1024*1024)
+#define THP_ENABLED     "/sys/kernel/mm/transparent_hugepage/enabled"
+
+static struct {
+  char * base;
+  char * next;
+  char * end;
+  size_t mapped;
+  size_t page_size;
+  align_placement placement;
+} arena;
+
 static inline int power_of_two (size_t p) {
   return p && !(p & (p - 1));
 }
 
+static inline int in_arena (const void * ptr) {
+  return (const char *) ptr >= arena.base && (const char *) ptr < arena.end;
+}
+
+/* carves a block out of the arena, NULL if it does not fit */
+static void * align_arena_malloc (size_t alignment, size_t size,
+				  size_t padding) {
+  uintptr_t p;
+
+  if (arena.base == NULL)
+    return NULL;
+
+  if (alignment < CACHE_LINE)
+    alignment = CACHE_LINE;
+
+  p = ((uintptr_t) arena.next + alignment-1) & ~(uintptr_t) (alignment-1);
+
+  if (p + size + padding > (uintptr_t) arena.end)
+    return NULL;
+
+  arena.next = (char *) (p + size + padding);
+
+  if (arena.placement != NULL)
+    arena.placement((void *) p, size);
+
+  memset((char *) p + size, 0x0, padding);
+
+  return (void *) p;
+}
+
+/* whether the kernel hands out transparent huge pages on request */
+static int align_arena_thp (void) {
+  char buffer[128];
+  FILE * f;
+  int r = 0;
+
+  f = fopen(THP_ENABLED, "r");
+
+  if (f == NULL)
+    return 0;
+
+  if (fgets(buffer, sizeof(buffer), f) != NULL)
+    r = strstr(buffer, "[never]") == NULL;
+
+  fclose(f);
+
+  return r;
+}
+
+void align_arena_free (void) {
+  if (arena.base == NULL)
+    return;
+
+  munmap(arena.base, arena.mapped);
+
+  arena.base = NULL;
+  arena.next = NULL;
+  arena.end  = NULL;
+  arena.mapped = 0;
+  arena.page_size = 0;
+}
+
+size_t align_arena_init (size_t size) {
+  void * p;
+
+  if (arena.base != NULL)
+    return arena.page_size;
+
+  size = (size + HUGE_PAGE_SIZE-1) & ~(size_t) (HUGE_PAGE_SIZE-1);
+
+  /* explicit huge pages, fails unless the pool is large enough */
+  p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+	   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+  if (p != MAP_FAILED) {
+    arena.base = p;
+    arena.mapped = size;
+    arena.page_size = HUGE_PAGE_SIZE;
+  } else {
+    uintptr_t base;
+
+    /* map an extra huge page so the region can start on one */
+    p = mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (p == MAP_FAILED)
+      return 0;
+
+    base = ((uintptr_t) p + HUGE_PAGE_SIZE-1) & ~(uintptr_t) (HUGE_PAGE_SIZE-1);
+
+    if (base > (uintptr_t) p)
+      munmap(p, base - (uintptr_t) p);
+    munmap((char *) base + size,
+	   (uintptr_t) p + HUGE_PAGE_SIZE - base);
+
+    arena.base = (char *) base;
+    arena.mapped = size;
+
+    if (align_arena_thp() &&
+	madvise(arena.base, size, MADV_HUGEPAGE) == 0)
+      arena.page_size = HUGE_PAGE_SIZE;
+    else
+      arena.page_size = sysconf(_SC_PAGESIZE);
+  }
+
+  arena.next = arena.base;
+  arena.end  = arena.base + size;
+
+  return arena.page_size;
+}
+
+void align_arena_placement (align_placement hook) {
+  arena.placement = hook;
+}
+
 void align_free (void * ptr) {
   void * p;
 
   if (ptr == NULL)
     return;
 
+  /* released all at once by align_arena_free */
+  if (in_arena(ptr))
+    return;
+
   p = *((void **) ptr - 1);
   free(p);
 }
@@ -32,6 +168,11 @@ void * align_padded_malloc (size_t alignment, size_t size, size_t padding) {
     return NULL;
   }
 
+  p = align_arena_malloc(alignment, size, padding);
+
+  if (p != NULL)
+    return p;
+
   /* we store the malloc'd pointer right before the
      returned pointer so that we can free later.
      in case we don't have room to store the pointer,
@@ -52,6 +193,10 @@ void * align_padded_malloc (size_t alignment, size_t size, size_t padding) {
     r += alignment;
 
   *((void **) (n + r) - 1) = p;
+
+  if (arena.placement != NULL)
+    arena.placement((void *) (n + r), size);
+
   memset((char *) (n + r) + size, 0x0, padding);
 
   return (void *) (n + r);
@@ -16,4 +16,24 @@ extern void * align_malloc (size_t alignment, size_t size);
    of the array is not zeroed out. */
 extern void * align_padded_malloc (size_t alignment, size_t size, size_t padding);
 
+/* called with every block handed out, from the arena or not,
+   before anything else touches it, decides where its pages end up.
+   the padding is touched afterwards by the calling thread. */
+typedef void (* align_placement) (void * ptr, size_t size);
+
+/* releases the arena, all memory handed out from it becomes
+   invalid. align_free on such memory is a no-op. */
+extern void align_arena_free (void);
+
+/* reserves a single contiguous region of at least size bytes that
+   the allocations above are carved from until it is exhausted.
+   tries explicit huge pages, then transparent huge pages, then
+   regular pages. returns the size of the pages backing it or 0 if
+   nothing could be reserved. */
+extern size_t align_arena_init (size_t size);
+
+/* sets the hook that places the pages of new blocks, NULL leaves
+   placement to whatever thread touches them first. */
+extern void align_arena_placement (align_placement hook);
+
 #endif /* ALIGN_MALLOC_H */
@@ -0,0 +1,71 @@
+#include <limits.h>
+#include <unistd.h>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "barrier.h"
+#include "nbody-openmp.h"
+
+#define CACHE_LINE 64
+
+/*
+ * Centralised barrier. The last thread to arrive resets the count
+ * and bumps the generation, everybody else waits for the generation
+ * to change. The generation takes the place of the sense flag of a
+ * sense reversing barrier, a waiter compares against the value it
+ * read on arrival so no per thread sense is needed, and as a 32 bit
+ * word it doubles as the futex. Arrivals and the generation live on
+ * separate cache lines so that spinning threads do not disturb the
+ * ones still arriving.
+ */
+static struct {
+  unsigned int arrived  __attribute__((aligned(CACHE_LINE)));
+  unsigned int generation __attribute__((aligned(CACHE_LINE)));
+  unsigned int sleepers;
+} barrier __attribute__((aligned(CACHE_LINE)));
+
+static inline void barrier_pause (void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+void barrier_wait (void) {
+  unsigned int threads = nbody_omp_threads();
+  unsigned int generation;
+  int spin;
+
+  if (threads == 1)
+    return;
+
+  generation = __atomic_load_n(&barrier.generation, __ATOMIC_ACQUIRE);
+
+  if (__atomic_add_fetch(&barrier.arrived, 1, __ATOMIC_ACQ_REL) == threads) {
+    /* nobody arrives again before the generation changes */
+    __atomic_store_n(&barrier.arrived, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&barrier.generation, generation+1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&barrier.sleepers, __ATOMIC_SEQ_CST) > 0)
+      syscall(SYS_futex, &barrier.generation, FUTEX_WAKE_PRIVATE,
+	      INT_MAX, NULL, NULL, 0);
+
+    return;
+  }
+
+  for (spin = 0; spin < BARRIER_SPIN; spin++) {
+    if (__atomic_load_n(&barrier.generation, __ATOMIC_ACQUIRE) != generation)
+      return;
+
+    barrier_pause();
+  }
+
+  __atomic_add_fetch(&barrier.sleepers, 1, __ATOMIC_SEQ_CST);
+
+  /* returns at once if the generation already moved on */
+  while (__atomic_load_n(&barrier.generation, __ATOMIC_SEQ_CST) == generation)
+    syscall(SYS_futex, &barrier.generation, FUTEX_WAIT_PRIVATE,
+	    generation, NULL, NULL, 0);
+
+  __atomic_sub_fetch(&barrier.sleepers, 1, __ATOMIC_SEQ_CST);
+}
@@ -0,0 +1,13 @@
+#ifndef BARRIER_H
+#define BARRIER_H 1
+
+/* iterations a thread spins before it sleeps in the kernel */
+#define BARRIER_SPIN 4096
+
+/* waits until every thread of the current team has arrived. spins
+   first since at small n the other threads are typically only a few
+   microseconds behind, then sleeps on a futex so that an
+   oversubscribed machine is not kept busy. */
+extern void barrier_wait (void);
+
+#endif /* BARRIER_H */
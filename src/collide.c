@@ -0,0 +1,157 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "align_malloc.h"
+#include "collide.h"
+#include "nbody-openmp.h"
+#include "physics.h"
+#include "reorder.h"
+
+/* first particle of every bucket and the next one in its bucket, n
+   ends a list */
+static size_t * head;
+static size_t * next;
+static size_t buckets;
+
+/* nearest particle within COLLISION_DISTANCE, n when there is none */
+static size_t * near;
+
+static unsigned char * keep;
+
+static inline size_t collide_bucket (int64_t x, int64_t y) {
+  uint64_t h = (uint64_t) x*UINT64_C(0x9e3779b97f4a7c15) ^
+    (uint64_t) y*UINT64_C(0xc2b2ae3d27d4eb4f);
+
+  return (h ^ (h >> 32)) & (buckets - 1);
+}
+
+static inline int64_t collide_cell (value x) {
+  return (int64_t) floor(x/COLLISION_DISTANCE);
+}
+
+static void collide_hash (size_t n, const value * px, const value * py) {
+  size_t i;
+
+  NBODY_OMP_FOR
+  for (i = 0; i < buckets; i++)
+    head[i] = n;
+
+  /* the order within a bucket depends on the threads, the search
+     below does not */
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++) {
+    size_t b = collide_bucket(collide_cell(px[i]), collide_cell(py[i]));
+
+    next[i] = __atomic_exchange_n(&head[b], i, __ATOMIC_RELAXED);
+  }
+}
+
+static void collide_search (size_t n, const value * px, const value * py) {
+  size_t i;
+
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++) {
+    value d = COLLISION_DISTANCE*COLLISION_DISTANCE;
+    int64_t x = collide_cell(px[i]);
+    int64_t y = collide_cell(py[i]);
+    size_t k = n;
+    int dx, dy;
+
+    for (dy = -1; dy <= 1; dy++) {
+      for (dx = -1; dx <= 1; dx++) {
+	size_t j;
+
+	for (j = head[collide_bucket(x + dx, y + dy)]; j != n; j = next[j]) {
+	  value r[VECTOR_SIZE];
+	  value s;
+
+	  r[0] = px[j] - px[i];
+	  r[1] = py[j] - py[i];
+
+	  s = r[0]*r[0] + r[1]*r[1];
+
+	  /* ties go to the lower slot */
+	  if (j != i && (s < d || (s == d && j < k))) {
+	    d = s;
+	    k = j;
+	  }
+	}
+      }
+    }
+
+    near[i] = k;
+  }
+}
+
+/* j into i */
+static void collide_merge (size_t i, size_t j,
+			   value * px, value * py,
+			   value * vx, value * vy,
+			   value * m) {
+  double M = (double) m[i] + m[j];
+
+  if (M > 0.0) {
+    px[i] = (m[i]*(double) px[i] + m[j]*(double) px[j])/M;
+    py[i] = (m[i]*(double) py[i] + m[j]*(double) py[j])/M;
+    vx[i] = (m[i]*(double) vx[i] + m[j]*(double) vx[j])/M;
+    vy[i] = (m[i]*(double) vy[i] + m[j]*(double) vy[j])/M;
+  }
+
+  m[i] = M;
+}
+
+void collide_free (void) {
+  align_free(keep);
+  align_free(near);
+  align_free(next);
+  align_free(head);
+}
+
+void collide_init (size_t n) {
+  buckets = 1;
+
+  while (buckets < COLLISION_TABLE_LOAD*n)
+    buckets <<= 1;
+
+  head = align_malloc(ALIGN_BOUNDARY, buckets*sizeof(size_t));
+  next = align_malloc(ALIGN_BOUNDARY, n*sizeof(size_t));
+  near = align_malloc(ALIGN_BOUNDARY, n*sizeof(size_t));
+  keep = align_malloc(ALIGN_BOUNDARY, n*sizeof(unsigned char));
+
+  if (head == NULL || next == NULL || near == NULL || keep == NULL) {
+    perror(__func__);
+    exit(EXIT_FAILURE);
+  }
+}
+
+size_t collide_particles (size_t n, size_t * id,
+			  value * px, value * py,
+			  value * vx, value * vy,
+			  value * m) {
+  size_t i;
+
+  collide_hash(n, px, py);
+  collide_search(n, px, py);
+
+  /* the lower slot of a pair takes in the higher one, the lists are
+     done with so next holds which */
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++) {
+    size_t k = near[i];
+    int pair = k != n && near[k] == i;
+
+    next[i] = pair && i < k ? k : n;
+    keep[i] = !pair || i < k;
+  }
+
+  physics_merge(n, next, m);
+
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++)
+    if (next[i] != n)
+      collide_merge(i, next[i], px, py, vx, vy, m);
+
+  return reorder_compact(n, keep, id, px, py, vx, vy, m);
+}
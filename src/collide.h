@@ -0,0 +1,34 @@
+#ifndef COLLIDE_H
+#define COLLIDE_H 1
+
+#include <stddef.h>
+#include "value.h"
+
+/*
+ * Particles closer than COLLISION_DISTANCE merge. The particles are
+ * hashed by their cell on a grid of COLLISION_DISTANCE sized cells,
+ * so only the particles in the neighbouring cells are looked at.
+ * Two particles merge when each is the other's nearest, into the
+ * lower slot, keeping their mass, center of mass and momentum.
+ *
+ * The hash table has COLLISION_TABLE_LOAD times as many buckets as
+ * there are particles, rounded up to a power of two.
+ */
+#define COLLISION_DISTANCE   value_literal(1e-3) /* m */
+#define COLLISION_TABLE_LOAD 2
+
+/* frees underlying resources */
+extern void collide_free (void);
+
+/* initializes the collisions of up to n particles */
+extern void collide_init (size_t n);
+
+/* merges the colliding particles and compacts the rest, the ids
+   follow their particles. returns the new number of particles.
+   must be called by every thread. */
+extern size_t collide_particles (size_t n, size_t * id,
+				 value * px, value * py,
+				 value * vx, value * vy,
+				 value * m);
+
+#endif /* COLLIDE_H */
@@ -421,6 +421,7 @@ static void draw_font_fps (size_t n, value dt) {
 static value draw_camera[2];
 static value draw_camera_zoom;
 static size_t draw_camera_focus;
+static size_t draw_camera_slot;
 
 static GLfloat draw_camera_mvp[4][4];
 static GLfloat draw_camera_mt1[4][4];
@@ -456,6 +457,21 @@ static void draw_camera_reset (void) {
   draw_camera[1] = value_literal(0.0);
 
   draw_camera_focus = 0;
+  draw_camera_slot = 0;
+}
+
+/* the focus names a particle, find the slot it currently is in */
+static void draw_camera_find (size_t n, const size_t * id) {
+  size_t i;
+
+  draw_camera_slot = 0;
+
+  for (i = 0; i < n; i++) {
+    if (id[i] == draw_camera_focus % n) {
+      draw_camera_slot = i;
+      break;
+    }
+  }
 }
 
 static void draw_camera_update (size_t n,
@@ -475,8 +491,8 @@ static void draw_camera_update (size_t n,
       draw_camera[0] += value_literal(0.05)/draw_camera_zoom;
     break;
   case CAMERA_FOCUS:
-    draw_camera[0] = px[draw_camera_focus % n];
-    draw_camera[1] = py[draw_camera_focus % n];
+    draw_camera[0] = px[draw_camera_slot];
+    draw_camera[1] = py[draw_camera_slot];
     break;
   }
 
@@ -635,8 +651,8 @@ static void draw_sprite_load_calc (size_t n,
     value Ek;
 
     if (draw_camera_mode == CAMERA_FOCUS) {
-      x -= vx[draw_camera_focus % n];
-      y -= vy[draw_camera_focus % n];
+      x -= vx[draw_camera_slot];
+      y -= vy[draw_camera_slot];
     }
 
     Ek = value_literal(0.5)*m[i]*(x*x + y*y);
@@ -831,6 +847,7 @@ unsigned int draw_input (unsigned int app_state, value * dt) {
 }
 
 void draw_particles (value dt, size_t n,
+		     const size_t * id,
 		     const value * px, const value * py,
 		     const value * vx, const value * vy,
 		     const value * m) {
@@ -846,6 +863,7 @@ void draw_particles (value dt, size_t n,
 
   glUseProgram(draw_shader); CHECK_GL();
 
+  draw_camera_find(n, id);
   draw_camera_update(n, px, py);
   draw_camera_upload_mvp();
 
@@ -13,6 +13,7 @@ unsigned int draw_input (unsigned int app_state, value * dt) {
 }
 
 void draw_particles (value dt, size_t n,
+		     const size_t * id,
 		     const value * px, const value * py,
 		     const value * vx, const value * vy,
 		     const value * m) {
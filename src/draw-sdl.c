@@ -98,6 +98,7 @@ static int scale;
 static value zoom;
 
 static size_t focus;
+static size_t focus_slot;
 
 enum {
   CAMERA_FREE  = 0,
@@ -135,6 +136,20 @@ static void draw_camera (value px, value py, SDL_Rect * rect) {
 /* forward declaration */
 static void draw_sprite_resize (value zoom);
 
+/* the focus names a particle, find the slot it currently is in */
+static void draw_camera_find (size_t n, const size_t * id) {
+  size_t i;
+
+  focus_slot = 0;
+
+  for (i = 0; i < n; i++) {
+    if (id[i] == focus % n) {
+      focus_slot = i;
+      break;
+    }
+  }
+}
+
 static void draw_camera_update (size_t n, const value * px, const value * py) {
   switch (camera_mode) {
   case CAMERA_FREE:
@@ -151,8 +166,8 @@ static void draw_camera_update (size_t n, const value * px, const value * py) {
       camera[0] += value_literal(0.05)/zoom;
     break;
   case CAMERA_FOCUS:
-    camera[0] = px[focus % n];
-    camera[1] = py[focus % n];
+    camera[0] = px[focus_slot];
+    camera[1] = py[focus_slot];
     break;
   }
 
@@ -260,8 +275,8 @@ static inline void draw_sprite_calculate_alphas (size_t n,
     value y = vy[i];
 
     if (camera_mode == CAMERA_FOCUS) {
-      x -= vx[focus % n];
-      y -= vy[focus % n];
+      x -= vx[focus_slot];
+      y -= vy[focus_slot];
     }
 
     Ek = draw_sprite_kinetic(x, y, m[i]);
@@ -519,6 +534,7 @@ static inline void draw_particle_2d (value px, value py, Uint8 alpha) {
 }
 
 void draw_particles (value dt, size_t n,
+		     const size_t * id,
 		     const value * px, const value * py,
 		     const value * vx, const value * vy,
 		     const value * m) {
@@ -526,19 +542,21 @@ void draw_particles (value dt, size_t n,
 
   draw_time = SDL_GetTicks();
 
+  draw_camera_find(n, id);
   draw_camera_update(n, px, py);
   draw_sprite_calculate_alphas(n, vx, vy, m);
 
   SDL_FillRect(screen, NULL, 0);
 
+  /* trails follow particles, not slots */
   for (i = 0; i < n; i++)
-    draw_trail_record(i, px[i], py[i]);
+    draw_trail_record(id[i], px[i], py[i]);
 
   for (i = 0; i < n; i++) {
     draw_particle_2d(px[i], py[i], star_alphas[i]);
 
     if (trail_active)
-      draw_trail_replay(i, n);
+      draw_trail_replay(id[i], n);
   }
 
   draw_font_fps(n, dt);
@@ -556,6 +574,7 @@ void draw_reset (size_t n) {
   camera[1] = value_literal(0.0);
 
   focus = 0;
+  focus_slot = 0;
   frame = 0;
   draw_time = 0;
 
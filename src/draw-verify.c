@@ -0,0 +1,309 @@
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "physics.h"
+#ifdef PHYSICS_RSQRT
+#include "rsqrt.h"
+#endif
+
+#include "draw-verify.h"
+
+static const double G = GRAVITATIONAL_CONSTANT;
+
+static size_t particles;
+static unsigned int steps;
+static unsigned int checked;
+
+/* everything below is indexed by particle id */
+static double * mass;
+
+/* the particles as the backend left them after the last step */
+static double * lx;
+static double * ly;
+static double * lvx;
+static double * lvy;
+
+/* the reference trajectory and its accelerations */
+static double * rx;
+static double * ry;
+static double * rvx;
+static double * rvy;
+static double * rax;
+static double * ray;
+
+/* scratch */
+static double * sx;
+static double * sy;
+static double * sax;
+static double * say;
+static double * tax;
+static double * tay;
+
+static double acceleration_error;
+static double trajectory_error;
+
+/* accelerations at x, y in double precision */
+static void verify_accelerations (const double * x, const double * y,
+				  double * ax, double * ay) {
+  size_t i, j;
+
+  for (i = 0; i < particles; i++) {
+    double a[2] = {0.0, 0.0};
+
+    for (j = 0; j < particles; j++) {
+      double r[2], s;
+
+      r[0] = x[j] - x[i];
+      r[1] = y[j] - y[i];
+
+      s = r[0]*r[0] + r[1]*r[1] + (double) SOFTENING*SOFTENING;
+      s = mass[j]/(s*sqrt(s));
+
+      a[0] += r[0]*s;
+      a[1] += r[1]*s;
+    }
+
+    ax[i] = G*a[0];
+    ay[i] = G*a[1];
+  }
+}
+
+/* rounds a value of the reference trajectory the way the backend
+   stores it, so that it makes the same rounding errors step after
+   step. they are the same way every step where the positions and
+   velocities change little, and outgrow any error of the pulls. */
+static void verify_round (double * x) {
+#ifndef PHYSICS_DOUBLE
+  *x = (value) *x;
+#endif
+}
+
+/* a difference e from the reference less the rounding of the
+   single precision values of the backend, which is no error of its
+   accelerations but can be larger than them */
+static double verify_unrounded (double e, double rounding) {
+  e = fabs(e) - rounding;
+
+  return e > 0.0 ? e : 0.0;
+}
+
+/* the velocity error of a step of dt from the last particles, which
+   ended at vx, vy in the backend, relative to the velocity change */
+static double verify_step (double dt, size_t n, const size_t * id,
+			   const value * vx, const value * vy) {
+  double error = 0.0, change = 0.0;
+  size_t i;
+
+  verify_accelerations(lx, ly, sax, say);
+
+  for (i = 0; i < particles; i++) {
+    sx[i] = lx[i] + (lvx[i] + 0.5*sax[i]*dt)*dt;
+    sy[i] = ly[i] + (lvy[i] + 0.5*say[i]*dt)*dt;
+  }
+
+  verify_accelerations(sx, sy, tax, tay);
+
+  for (i = 0; i < n; i++) {
+    size_t k = id[i];
+    double dvx = 0.5*(sax[k] + tax[k])*dt;
+    double dvy = 0.5*(say[k] + tay[k])*dt;
+    /* the velocities the step starts and ends with are each
+       rounded by up to half an ulp */
+    double ex =
+      verify_unrounded(vx[i] - (lvx[k] + dvx), FLT_EPSILON*fabs(vx[i]));
+    double ey =
+      verify_unrounded(vy[i] - (lvy[k] + dvy), FLT_EPSILON*fabs(vy[i]));
+
+    error += ex*ex + ey*ey;
+    change += dvx*dvx + dvy*dvy;
+  }
+
+  return change > 0.0 ? sqrt(error/change) : 0.0;
+}
+
+/* advances the reference by dt and returns the distance of px, py
+   from it relative to the size of the system */
+static double verify_trajectory (double dt, size_t n, const size_t * id,
+				 const value * px, const value * py) {
+  double error = 0.0, size = 0.0;
+  double cm[2] = {0.0, 0.0}, M = 0.0;
+  size_t i;
+
+  for (i = 0; i < particles; i++) {
+    rx[i] += (rvx[i] + 0.5*rax[i]*dt)*dt;
+    ry[i] += (rvy[i] + 0.5*ray[i]*dt)*dt;
+    verify_round(&rx[i]);
+    verify_round(&ry[i]);
+  }
+
+  verify_accelerations(rx, ry, tax, tay);
+
+  for (i = 0; i < particles; i++) {
+    rvx[i] += 0.5*(rax[i] + tax[i])*dt;
+    rvy[i] += 0.5*(ray[i] + tay[i])*dt;
+    verify_round(&rvx[i]);
+    verify_round(&rvy[i]);
+
+    rax[i] = tax[i];
+    ray[i] = tay[i];
+
+    cm[0] += mass[i]*rx[i];
+    cm[1] += mass[i]*ry[i];
+    M += mass[i];
+  }
+
+  if (M > 0.0) {
+    cm[0] /= M;
+    cm[1] /= M;
+  }
+
+  for (i = 0; i < n; i++) {
+    size_t k = id[i];
+    double ex = px[i] - rx[k];
+    double ey = py[i] - ry[k];
+
+    error += ex*ex + ey*ey;
+    size += (rx[k] - cm[0])*(rx[k] - cm[0]) + (ry[k] - cm[1])*(ry[k] - cm[1]);
+  }
+
+  return size > 0.0 ? sqrt(error/size) : 0.0;
+}
+
+void draw_free (void) {
+  double acceleration = VERIFY_ACCELERATION;
+  double trajectory = VERIFY_TRAJECTORY;
+  int passed;
+
+#ifdef PHYSICS_RSQRT
+  if (rsqrt_mode == RSQRT_ESTIMATE) {
+    acceleration = VERIFY_ACCELERATION_ESTIMATE;
+    trajectory = VERIFY_TRAJECTORY_ESTIMATE;
+  }
+#endif
+
+  passed = acceleration_error <= acceleration &&
+    trajectory_error <= trajectory;
+
+  printf("verified %u steps, acceleration error %.3g of %.3g, "
+	 "trajectory error %.3g of %.3g, %s\n",
+	 checked,
+	 acceleration_error, acceleration,
+	 trajectory_error, trajectory,
+	 passed ? "passed" : "FAILED");
+
+  free(tay);
+  free(tax);
+  free(say);
+  free(sax);
+  free(sy);
+  free(sx);
+  free(ray);
+  free(rax);
+  free(rvy);
+  free(rvx);
+  free(ry);
+  free(rx);
+  free(lvy);
+  free(lvx);
+  free(ly);
+  free(lx);
+  free(mass);
+
+  /* so that scripts and make verify see it */
+  if (!passed)
+    exit(EXIT_FAILURE);
+}
+
+void draw_init (int width, int height, int fps, size_t n) {
+  double ** arrays[] = {
+    &mass, &lx, &ly, &lvx, &lvy, &rx, &ry, &rvx, &rvy, &rax, &ray,
+    &sx, &sy, &sax, &say, &tax, &tay
+  };
+  size_t i;
+
+  for (i = 0; i < sizeof(arrays)/sizeof(arrays[0]); i++) {
+    *arrays[i] = malloc(n*sizeof(double));
+
+    if (*arrays[i] == NULL) {
+      perror(__func__);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  draw_reset(n);
+}
+
+unsigned int draw_input (unsigned int app_state, value * dt) {
+  return steps > VERIFY_STEPS ? EXIT : app_state;
+}
+
+void draw_particles (value dt, size_t n,
+		     const size_t * id,
+		     const value * px, const value * py,
+		     const value * vx, const value * vy,
+		     const value * m) {
+  size_t i;
+
+  /* merged or escaped particles have no reference to follow */
+  if (n != particles && steps > 0) {
+    if (steps <= VERIFY_STEPS)
+      printf("verify: particles were removed after %u steps\n", checked);
+
+    steps = VERIFY_STEPS + 1;
+    return;
+  }
+
+  if (steps == 0) {
+    particles = n;
+
+    for (i = 0; i < n; i++) {
+      size_t k = id[i];
+
+      mass[k] = m[i];
+
+      rx[k] = px[i];
+      ry[k] = py[i];
+      rvx[k] = vx[i];
+      rvy[k] = vy[i];
+    }
+
+    verify_accelerations(rx, ry, rax, ray);
+  } else {
+    double a = verify_step(dt, n, id, vx, vy);
+    double t = verify_trajectory(dt, n, id, px, py);
+
+    if (a > acceleration_error)
+      acceleration_error = a;
+
+    if (t > trajectory_error)
+      trajectory_error = t;
+
+    checked += 1;
+  }
+
+  for (i = 0; i < n; i++) {
+    size_t k = id[i];
+
+    lx[k] = px[i];
+    ly[k] = py[i];
+    lvx[k] = vx[i];
+    lvy[k] = vy[i];
+  }
+
+  steps += 1;
+}
+
+int draw_redraw (void) {
+  return 1;
+}
+
+void draw_reset (size_t n) {
+  particles = n;
+  steps = 0;
+  checked = 0;
+
+  acceleration_error = 0.0;
+  trajectory_error = 0.0;
+}
@@ -0,0 +1,39 @@
+#ifndef DRAW_VERIFY_H
+#define DRAW_VERIFY_H 1
+
+#include "draw.h"
+
+/*
+ * Instead of drawing, every step of the physics backend is checked
+ * against a double precision verlet integration of the same
+ * particles, which draw-verify.mk has take one step per batch.
+ *
+ * The acceleration error is that of a single step started from the
+ * particles as the backend left them, the velocity it ends with is
+ * compared to the reference and the difference is taken relative
+ * to the change in velocity, rms over all particles. The trajectory
+ * error is the rms distance from a reference integrated on its own
+ * from the first step on, relative to the rms distance from the
+ * center of mass.
+ *
+ * At few particles or small timesteps the rounding of the backend's
+ * single precision positions and velocities is larger than the
+ * error of its accelerations. The acceleration error leaves out
+ * what rounding the velocities can account for, and the reference
+ * trajectory rounds its positions and velocities to single
+ * precision every step as the backend does, unless PHYSICS_DOUBLE
+ * says the backend keeps them in double precision.
+ *
+ * The largest of either over VERIFY_STEPS steps is reported and
+ * checked against the tolerance of the backend's rsqrt mode, see
+ * rsqrt.h, those without a mode are held to the newton one.
+ */
+#define VERIFY_STEPS 100
+
+#define VERIFY_ACCELERATION_ESTIMATE 1e-3
+#define VERIFY_ACCELERATION          1e-4
+
+#define VERIFY_TRAJECTORY_ESTIMATE   1e-5
+#define VERIFY_TRAJECTORY            1e-6
+
+#endif /* DRAW_VERIFY_H */
@@ -0,0 +1,5 @@
+# one step per batch, so that every step is seen
+CPPFLAGS += -DBATCH_MAX=1
+
+draw.o : draw.c
+	$(CC) $(CPPFLAGS) $(CFLAGS) -Wno-unused-parameter -c -o $@ $<
@@ -21,6 +21,7 @@ extern unsigned int draw_input (unsigned int app_state, value * dt);
 
 /* draws particles to screen */
 extern void draw_particles (value dt, size_t n,
+			    const size_t * id,
 			    const value * px, const value * py,
 			    const value * vx, const value * vy,
 			    const value * m);
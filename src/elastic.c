@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "align_malloc.h"
+#include "elastic.h"
+#include "nbody-openmp.h"
+
+#define CACHE_LINE 64
+
+/* the work of every thread, on a cache line of its own */
+struct elastic_clock {
+  double start;
+  double work;
+} __attribute__((aligned(CACHE_LINE)));
+
+static struct elastic_clock * clocks = NULL;
+
+static int off = 1;
+static int fixed;
+static int most;        /* threads there were at startup */
+static int team;        /* threads asked for */
+
+/* the share of every thread and where it starts, shares_n is the
+   team they are for and 0 before there are any */
+static double * share = NULL;
+static double * bound = NULL;
+static int shares_n = 0;
+
+/* steps per second of the last window at every team size, 0 when
+   not known, for particles particles */
+static double * rate = NULL;
+static size_t particles = 0;
+
+/* the team size before the one being tried, 0 when not trying, and
+   whether the next periodic try is downwards */
+static int from = 0;
+static int down = 0;
+
+/* the window so far */
+static unsigned int windows = 0;
+static double steps = 0.0;
+static double seconds_sum = 0.0;
+
+static double elastic_timer (void) {
+  struct timespec now;
+
+  (void) clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec + 1e-9*now.tv_nsec;
+}
+
+void elastic_free (void) {
+  align_free(clocks);
+
+  free(rate);
+  free(bound);
+  free(share);
+
+  clocks = NULL;
+  rate = NULL;
+  bound = NULL;
+  share = NULL;
+
+  shares_n = 0;
+  off = 1;
+}
+
+void elastic_init (int threads) {
+  const char * mode = getenv("NBODY_ELASTIC");
+  int t;
+
+  elastic_free();
+
+  most = threads;
+  team = nbody_omp_max_threads();
+  fixed = getenv("OMP_NUM_THREADS") != NULL;
+
+  if (mode != NULL && strcmp(mode, "off") != 0) {
+    fprintf(stderr, "%s: NBODY_ELASTIC must be off\n", __func__);
+    exit(EXIT_FAILURE);
+  }
+
+  if (mode != NULL) {
+    printf("elastic off\n");
+    return;
+  }
+
+  clocks = align_malloc(CACHE_LINE, most*sizeof(*clocks));
+  share = malloc(most*sizeof(*share));
+  bound = malloc((most + 1)*sizeof(*bound));
+  rate = calloc(most + 1, sizeof(*rate));
+
+  if (clocks == NULL || share == NULL || bound == NULL || rate == NULL) {
+    perror(__func__);
+    exit(EXIT_FAILURE);
+  }
+
+  for (t = 0; t < most; t++)
+    clocks[t].work = 0.0;
+
+  off = 0;
+
+  printf("elastic, threads %d of %d%s\n",
+	 team, most, fixed ? ", fixed" : "");
+}
+
+void elastic_range (size_t units, size_t * u0, size_t * u1) {
+  int t = nbody_omp_thread();
+  int threads = nbody_omp_threads();
+
+  if (shares_n != threads) {
+    *u0 = units*t/threads;
+    *u1 = units*(t+1)/threads;
+    return;
+  }
+
+  *u0 = units*bound[t] + 0.5;
+  *u1 = t+1 < threads ? units*bound[t+1] + 0.5 : units;
+}
+
+void elastic_begin (void) {
+  if (clocks != NULL)
+    clocks[nbody_omp_thread()].start = elastic_timer();
+}
+
+void elastic_end (void) {
+  struct elastic_clock * c;
+
+  if (clocks == NULL)
+    return;
+
+  c = &clocks[nbody_omp_thread()];
+  c->work += elastic_timer() - c->start;
+}
+
+/* moves every share halfway to what would have had all threads of
+   the last batch finish together. nothing changes when some thread
+   did no timed work, as when the kernel does not time any. */
+static void elastic_shares (int threads) {
+  double total = 0.0;
+  int t;
+
+  for (t = 0; t < threads; t++)
+    if (clocks[t].work <= 0.0)
+      return;
+
+  if (shares_n != threads)
+    for (t = 0; t < threads; t++)
+      share[t] = 1.0/threads;
+
+  for (t = 0; t < threads; t++)
+    total += share[t]/clocks[t].work;
+
+  bound[0] = 0.0;
+
+  for (t = 0; t < threads; t++) {
+    share[t] = 0.5*(share[t] + share[t]/clocks[t].work/total);
+    bound[t+1] = bound[t] + share[t];
+
+    clocks[t].work = 0.0;
+  }
+
+  shares_n = threads;
+}
+
+/* tries a team of threads instead of the current one */
+static void elastic_try (int threads) {
+  from = team;
+  team = threads;
+}
+
+/* the team size for the windows to come */
+static void elastic_window (size_t n, unsigned int k, double seconds,
+			    int threads) {
+  double r, last;
+  int t;
+
+  /* rates of other n do not compare */
+  if (n != particles) {
+    for (t = 0; t <= most; t++)
+      rate[t] = 0.0;
+
+    particles = n;
+    from = 0;
+    steps = 0.0;
+    seconds_sum = 0.0;
+  }
+
+  steps += k;
+  seconds_sum += seconds;
+
+  if (seconds_sum < ELASTIC_WINDOW)
+    return;
+
+  r = steps/seconds_sum;
+  last = rate[threads];
+  rate[threads] = r;
+
+  steps = 0.0;
+  seconds_sum = 0.0;
+
+  /* the window after a try decides it, fewer threads only have to
+     be as fast */
+  if (from != 0) {
+    int next = 2*threads - from;
+
+    windows = 0;
+
+    if (threads < from ?
+	r*(1.0 + ELASTIC_GAIN) < rate[from] :
+	r < (1.0 + ELASTIC_GAIN)*rate[from]) {
+      team = from;
+      from = 0;
+      return;
+    }
+
+    printf("elastic threads %d, was %d, %.4g steps/s\n", threads, from, r);
+    from = 0;
+
+    if (next >= 1 && next <= most)
+      elastic_try(next);
+
+    return;
+  }
+
+  if (last > 0.0 && r < ELASTIC_DROP*last && threads > 1) {
+    elastic_try(threads - 1);
+  } else if (++windows >= ELASTIC_PROBE) {
+    windows = 0;
+
+    if (down && threads > 1)
+      elastic_try(threads - 1);
+    else if (threads < most)
+      elastic_try(threads + 1);
+    else if (threads > 1)
+      elastic_try(threads - 1);
+
+    down = !down;
+  }
+}
+
+void elastic_adapt (size_t n, unsigned int k, double seconds) {
+  int threads = nbody_omp_threads();
+
+  if (off)
+    return;
+
+  elastic_shares(threads);
+
+  if (!fixed)
+    elastic_window(n, k, seconds, threads);
+}
+
+int elastic_threads (void) {
+  return team;
+}
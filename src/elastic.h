@@ -0,0 +1,57 @@
+#ifndef ELASTIC_H
+#define ELASTIC_H 1
+
+#include <stddef.h>
+
+/*
+ * Keeps the team of the main loop fitted to the cores it actually
+ * gets on a shared machine. Kernels that time the work of every
+ * thread between two barriers with elastic_begin and elastic_end and
+ * divide their loops with elastic_range hand each thread a share in
+ * proportion to how fast it went on the last batch, so a thread on a
+ * slow or busy core no longer holds up every barrier.
+ *
+ * The number of threads is adapted from the steps per second of the
+ * whole team, measured over windows of at least ELASTIC_WINDOW
+ * seconds of steps. A window that runs below ELASTIC_DROP of the
+ * last one at the same size, such as when other jobs start, tries
+ * one thread less, and every ELASTIC_PROBE windows one more or one
+ * less is tried in turn. A try is kept when it is at least
+ * ELASTIC_GAIN faster, or when it has fewer threads and is no more
+ * than that slower, and then the next size in the same direction is
+ * tried. Otherwise it is undone. The team never grows past the
+ * threads there were at startup, and is pinned anew whenever it
+ * changes.
+ *
+ * NBODY_ELASTIC=off in the environment keeps the team and static
+ * shares, setting OMP_NUM_THREADS keeps the team but not the shares.
+ */
+#define ELASTIC_WINDOW 0.25    /* s */
+#define ELASTIC_PROBE  16
+#define ELASTIC_DROP   0.8
+#define ELASTIC_GAIN   0.02
+
+/* starts with the team the next parallel region will have, which
+   may grow up to threads */
+extern void elastic_init (int threads);
+
+extern void elastic_free (void);
+
+/* the range of units, in the shares of the calling thread of the
+   team, [*u0, *u1) */
+extern void elastic_range (size_t units, size_t * u0, size_t * u1);
+
+/* brackets work of the calling thread, the time in between counts
+   towards its speed */
+extern void elastic_begin (void);
+extern void elastic_end (void);
+
+/* takes in a batch of k steps of n particles that took seconds and
+   the work timed since the last one. called by the master between
+   batches, when no thread is in elastic_range. */
+extern void elastic_adapt (size_t n, unsigned int k, double seconds);
+
+/* threads the team should have from the next parallel region on */
+extern int elastic_threads (void);
+
+#endif /* ELASTIC_H */
@@ -0,0 +1,13 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H 1
+
+/*
+ * An ensemble is a set of independent systems of ENSEMBLE_BODIES
+ * bodies each. Particles s*ENSEMBLE_BODIES up to
+ * (s+1)*ENSEMBLE_BODIES-1 make up system s, if n is not a multiple
+ * of ENSEMBLE_BODIES the last system has fewer bodies. Bodies of
+ * different systems do not interact.
+ */
+#define ENSEMBLE_BODIES 16
+
+#endif /* ENSEMBLE_H */
@@ -0,0 +1,188 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+#include "align_malloc.h"
+#include "escape.h"
+#include "nbody-openmp.h"
+#include "physics.h"
+#include "reorder.h"
+
+/* particles checked together, thread ranges are made of whole
+   blocks so every particle is checked the same way whatever the
+   number of threads */
+#define BLOCK 8
+
+static const value G = GRAVITATIONAL_CONSTANT;
+
+/* number of escapers so far */
+static size_t escaped;
+
+static unsigned char * keep;
+
+/* per thread mass, mass weighted positions and velocities, and
+   number of escapers */
+static double (* sums)[5];
+static size_t * counts;
+
+/* the check of particles lo to hi against a point of mass M at c
+   moving with u */
+static void escape_check (size_t lo, size_t hi,
+			  const value * px, const value * py,
+			  const value * vx, const value * vy,
+			  const value c[4], value M) {
+  value r2 = ESCAPE_RADIUS*ESCAPE_RADIUS;
+  size_t i = lo;
+
+#ifdef __AVX__
+  __m256 cx = _mm256_set1_ps(c[0]);
+  __m256 cy = _mm256_set1_ps(c[1]);
+  __m256 ux = _mm256_set1_ps(c[2]);
+  __m256 uy = _mm256_set1_ps(c[3]);
+  __m256 gm = _mm256_set1_ps(G*M);
+  __m256 rr = _mm256_set1_ps(r2);
+  __m256 half = _mm256_set1_ps(0.5f);
+  __m256 zero = _mm256_setzero_ps();
+
+  for (; i + BLOCK <= hi; i += BLOCK) {
+    __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&px[i]), cx);
+    __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&py[i]), cy);
+    __m256 wx = _mm256_sub_ps(_mm256_loadu_ps(&vx[i]), ux);
+    __m256 wy = _mm256_sub_ps(_mm256_loadu_ps(&vy[i]), uy);
+    __m256 d2, w2, e, out, far;
+    int bits, l;
+
+    d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+    w2 = _mm256_add_ps(_mm256_mul_ps(wx, wx), _mm256_mul_ps(wy, wy));
+
+    /* the energy per unit mass */
+    e = _mm256_sub_ps(_mm256_mul_ps(half, w2),
+		      _mm256_div_ps(gm, _mm256_sqrt_ps(d2)));
+
+    out = _mm256_add_ps(_mm256_mul_ps(dx, wx), _mm256_mul_ps(dy, wy));
+
+    far = _mm256_and_ps(_mm256_cmp_ps(d2, rr, _CMP_GT_OQ),
+			_mm256_cmp_ps(e, zero, _CMP_GT_OQ));
+    far = _mm256_and_ps(far, _mm256_cmp_ps(out, zero, _CMP_GT_OQ));
+
+    bits = _mm256_movemask_ps(far);
+
+    for (l = 0; l < BLOCK; l++)
+      keep[i + l] = !((bits >> l) & 1);
+  }
+#endif
+
+  for (; i < hi; i++) {
+    value dx = px[i] - c[0];
+    value dy = py[i] - c[1];
+    value wx = vx[i] - c[2];
+    value wy = vy[i] - c[3];
+    value d2 = dx*dx + dy*dy;
+    value e = value_literal(0.5)*(wx*wx + wy*wy) - G*M/sqrtv(d2);
+
+    keep[i] = !(d2 > r2 && e > value_literal(0.0) &&
+		dx*wx + dy*wy > value_literal(0.0));
+  }
+}
+
+void escape_free (void) {
+  free(counts);
+  free(sums);
+
+  align_free(keep);
+}
+
+void escape_init (size_t n) {
+  int threads = nbody_omp_max_threads();
+
+  keep = align_malloc(ALIGN_BOUNDARY, n*sizeof(unsigned char));
+
+  sums = malloc(threads*sizeof(*sums));
+  counts = malloc(threads*sizeof(*counts));
+
+  if (keep == NULL || sums == NULL || counts == NULL) {
+    perror(__func__);
+    exit(EXIT_FAILURE);
+  }
+
+  escape_reset();
+}
+
+size_t escape_particles (size_t n, size_t * id,
+			 value * px, value * py,
+			 value * vx, value * vy,
+			 value * m) {
+  int u, threads = nbody_omp_threads();
+  int k = nbody_omp_thread();
+  size_t blocks = (n + BLOCK-1)/BLOCK;
+  size_t lo = blocks*k/threads*BLOCK;
+  size_t hi = blocks*(k+1)/threads*BLOCK;
+  double s[5] = {0.0, 0.0, 0.0, 0.0, 0.0};
+  value c[4];
+  size_t i, j, total;
+
+  if (hi > n)
+    hi = n;
+
+  for (i = lo; i < hi; i++) {
+    s[0] += m[i];
+    s[1] += m[i]*(double) px[i];
+    s[2] += m[i]*(double) py[i];
+    s[3] += m[i]*(double) vx[i];
+    s[4] += m[i]*(double) vy[i];
+  }
+
+  for (j = 0; j < 5; j++)
+    sums[k][j] = s[j];
+
+  NBODY_OMP_BARRIER
+
+  /* every thread reduces in the same order */
+  for (j = 0; j < 5; j++)
+    s[j] = 0.0;
+
+  for (u = 0; u < threads; u++)
+    for (j = 0; j < 5; j++)
+      s[j] += sums[u][j];
+
+  if (s[0] <= 0.0)
+    return n;
+
+  for (j = 0; j < 4; j++)
+    c[j] = s[j + 1]/s[0];
+
+  escape_check(lo, hi, px, py, vx, vy, c, s[0]);
+
+  for (i = lo, j = 0; i < hi; i++)
+    j += !keep[i];
+
+  counts[k] = j;
+
+  NBODY_OMP_BARRIER
+
+  for (u = 0, total = 0; u < threads; u++)
+    total += counts[u];
+
+  if (total == 0)
+    return n;
+
+  n = reorder_compact(n, keep, id, px, py, vx, vy, m);
+
+  /* every thread is done with the old count */
+  NBODY_OMP_MASTER
+  escaped += total;
+
+  return n;
+}
+
+size_t escape_count (void) {
+  return escaped;
+}
+
+void escape_reset (void) {
+  escaped = 0;
+}
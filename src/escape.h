@@ -0,0 +1,36 @@
+#ifndef ESCAPE_H
+#define ESCAPE_H 1
+
+#include <stddef.h>
+#include "value.h"
+
+/*
+ * A particle escapes when it is further than ESCAPE_RADIUS from the
+ * center of mass, moving away from it and unbound from the mass of
+ * the whole system taken as a single point at the center. Escapers
+ * are taken out of the particles and only counted, their pull on
+ * the system and its pull on them are dropped.
+ */
+#define ESCAPE_RADIUS value_literal(16.0) /* m */
+
+/* frees underlying resources */
+extern void escape_free (void);
+
+/* initializes the escapes of up to n particles */
+extern void escape_init (size_t n);
+
+/* takes the escapers out and compacts the rest, the ids follow
+   their particles. returns the new number of particles. must be
+   called by every thread. */
+extern size_t escape_particles (size_t n, size_t * id,
+				value * px, value * py,
+				value * vx, value * vy,
+				value * m);
+
+/* number of particles escaped */
+extern size_t escape_count (void);
+
+/* starts counting anew */
+extern void escape_reset (void);
+
+#endif /* ESCAPE_H */
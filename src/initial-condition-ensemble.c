@@ -0,0 +1,95 @@
+#include <math.h>
+
+#include "physics.h"
+#include "rng.h"
+
+#include "initial-condition-ensemble.h"
+
+static const value G = GRAVITATIONAL_CONSTANT;
+
+/* a small solar system of the particles first up to last centered on
+   (cx, cy), px and py come in holding orbit radii and angles */
+static void initial_condition_system (size_t first, size_t last,
+				      value ratio, value cx, value cy,
+				      value * px, value * py,
+				      value * vx, value * vy,
+				      value * m) {
+  size_t i;
+  value M = value_literal(0.0);
+  value MP[VECTOR_SIZE] = {value_literal(0.0)};
+  value MV[VECTOR_SIZE] = {value_literal(0.0)};
+
+  if (last - first < 2) {
+    px[first] = cx;
+    py[first] = cy;
+    vx[first] = value_literal(0.0);
+    vy[first] = value_literal(0.0);
+    return;
+  }
+
+  for (i = first+1; i < last; i++)
+    M += m[i];
+
+  m[first] = ratio*M;
+
+  for (i = first+1; i < last; i++) {
+    value r = px[i];
+    value angle = py[i];
+    value abs_v = sqrtv(G*m[first]/r);
+
+    px[i] = r*cosv(angle);
+    py[i] = r*sinv(angle);
+
+    vx[i] = -abs_v*sinv(angle);
+    vy[i] =  abs_v*cosv(angle);
+
+    MP[0] += px[i]*m[i];
+    MP[1] += py[i]*m[i];
+
+    MV[0] += vx[i]*m[i];
+    MV[1] += vy[i]*m[i];
+  }
+
+  /* set sun so that center/velocity of mass is 0,0 */
+  px[first] = -MP[0]/m[first];
+  py[first] = -MP[1]/m[first];
+
+  vx[first] = -MV[0]/m[first];
+  vy[first] = -MV[1]/m[first];
+
+  for (i = first; i < last; i++) {
+    px[i] += cx;
+    py[i] += cy;
+  }
+}
+
+void initial_condition (size_t n,
+			value * px, value * py,
+			value * vx, value * vy,
+			value * m) {
+  size_t systems = (n + ENSEMBLE_BODIES-1)/ENSEMBLE_BODIES;
+  size_t side = ceil(sqrt(systems));
+  size_t s;
+
+  rng_normal_array(n, m, MASS_STANDARD_DEVIATION,
+		   MASS_EXPECTED_VALUE);
+
+  rng_uniform_array(n, px, ORBIT_RADIUS_MIN, ORBIT_RADIUS_MAX);
+  rng_uniform_array(n, py, 0.0, 2*M_PI);
+
+  /* systems on a square grid around the origin */
+  for (s = 0; s < systems; s++) {
+    size_t first = s*ENSEMBLE_BODIES;
+    size_t last = first + ENSEMBLE_BODIES < n ? first + ENSEMBLE_BODIES : n;
+    double t = systems > 1 ? s/(systems - 1.0) : 0.0;
+
+    value ratio = SOLAR_MASS_RATIO_MIN*
+      pow(SOLAR_MASS_RATIO_MAX/SOLAR_MASS_RATIO_MIN, t);
+
+    value cx = (s%side - (side - 1)/2.0)*SYSTEM_SPACING;
+    value cy = (s/side - (side - 1)/2.0)*SYSTEM_SPACING;
+
+    initial_condition_system(first, last, ratio, cx, cy,
+			     px, py, vx, vy, m);
+  }
+}
@@ -0,0 +1,20 @@
+#ifndef INITIAL_CONDITION_ENSEMBLE_H
+#define INITIAL_CONDITION_ENSEMBLE_H 1
+
+#include "ensemble.h"
+#include "initial-condition.h"
+
+#define MASS_STANDARD_DEVIATION        5e4       /* kg */
+#define MASS_EXPECTED_VALUE            5e5       /* kg */
+
+/* the central mass ratio is swept geometrically over the systems */
+#define SOLAR_MASS_RATIO_MIN           value_literal(1e1)       /* 1 (unitless) */
+#define SOLAR_MASS_RATIO_MAX           value_literal(1e3)       /* 1 (unitless) */
+
+#define ORBIT_RADIUS_MIN               0.2       /* m */
+#define ORBIT_RADIUS_MAX               1.0       /* m */
+
+/* distance between neighbouring systems on the grid */
+#define SYSTEM_SPACING                 value_literal(3.0)       /* m */
+
+#endif /* INITIAL_CONDITION_ENSEMBLE_H */
@@ -1,3 +1,4 @@
+#include "nbody-openmp.h"
 #include "physics.h"
 #include "rng.h"
 
@@ -9,22 +10,21 @@ void initial_condition (size_t n,
 			value * px, value * py,
 			value * vx, value * vy,
 			value * m) {
-  size_t i, j;
+  size_t i;
   value M = value_literal(0.0);
 
-  for (i = 0; i < n; i++) {
-    m[i] = rng_normal(MASS_STANDARD_DEVIATION,
-		      MASS_EXPECTED_VALUE);
+  rng_normal_array(n, m, MASS_STANDARD_DEVIATION,
+		   MASS_EXPECTED_VALUE);
 
+  for (i = 0; i < n; i++)
     M += m[i];
-  }
 
-  for (i = 0; i < n; i++) {
-    px[i] = rng_normal(1.0, 0.0);
-    py[i] = rng_normal(1.0, 0.0);
-  }
+  rng_normal_array(n, px, 1.0, 0.0);
+  rng_normal_array(n, py, 1.0, 0.0);
 
+  NBODY_OMP_PARALLEL_FOR
   for (i = 0; i < n; i++) {
+    size_t j;
     value x, y;
     value d[VECTOR_SIZE] = {value_literal(0.0)};
     value p[VECTOR_SIZE] = {value_literal(0.0)};
@@ -16,19 +16,16 @@ void initial_condition (size_t n,
   value MP[VECTOR_SIZE] = {value_literal(0.0)};
   value MV[VECTOR_SIZE] = {value_literal(0.0)};
 
-  for (i = 1; i < n; i++) {
-    m[i] = rng_normal(MASS_STANDARD_DEVIATION,
-			 MASS_EXPECTED_VALUE);
+  rng_normal_array(n-1, &m[1], MASS_STANDARD_DEVIATION,
+		   MASS_EXPECTED_VALUE);
 
+  for (i = 1; i < n; i++)
     M += m[i];
-  }
 
   m[0] = SOLAR_MASS_RATIO*M;
 
-  for (i = 1; i < n; i++) {
-    px[i] = rng_normal(0.5, 0.0);
-    py[i] = rng_normal(0.5, 0.0);
-  }
+  rng_normal_array(n-1, &px[1], 0.5, 0.0);
+  rng_normal_array(n-1, &py[1], 0.5, 0.0);
 
   for (i = 1; i < n; i++) {
     value x, y;
@@ -0,0 +1,13 @@
+#ifndef INITIAL_CONDITION_TRACERS_H
+#define INITIAL_CONDITION_TRACERS_H 1
+
+#include "initial-condition.h"
+
+#define MASS_STANDARD_DEVIATION        5e4       /* kg */
+#define MASS_EXPECTED_VALUE            5e5       /* kg */
+
+/* the first MASSIVE_PARTICLES particles have mass, the rest are
+   massless tracers that only feel gravity */
+#define MASSIVE_PARTICLES              1024
+
+#endif /* INITIAL_CONDITION_TRACERS_H */
@@ -0,0 +1,390 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "jit.h"
+#include "physics.h"
+#include "rsqrt.h"
+
+/* bytes of executable memory, plenty for JIT_ROWS kernels */
+#define JIT_SIZE 16384
+
+/* general purpose registers */
+#define JIT_RAX 0
+#define JIT_RCX 1
+#define JIT_RDX 2
+#define JIT_RSI 6
+#define JIT_RDI 7
+#define JIT_R8  8
+#define JIT_R9  9
+
+/* opcode maps and prefixes of the vex encoding */
+#define JIT_0F    1
+#define JIT_0F38  2
+#define JIT_NP    0
+#define JIT_66    1
+
+/* the vector instructions used, by opcode */
+#define JIT_VMOVUPS_LOAD  0x10
+#define JIT_VMOVUPS_STORE 0x11
+#define JIT_VSQRTPS       0x51
+#define JIT_VRSQRTPS      0x52
+#define JIT_VADDPS        0x58
+#define JIT_VMULPS        0x59
+#define JIT_VSUBPS        0x5c
+#define JIT_VDIVPS        0x5e
+#define JIT_VBROADCASTSS  0x18    /* in 0F38 with 66 */
+#define JIT_VFMADD231PS   0xb8    /* in 0F38 with 66 */
+
+/* vector registers of a kernel, the sums of row r are in
+   JIT_AX + 2*r and JIT_AX + 2*r+1 */
+#define JIT_X  0    /* px[j] */
+#define JIT_Y  1    /* py[j] */
+#define JIT_M  2    /* m[j] */
+#define JIT_RX 3
+#define JIT_RY 4
+#define JIT_S  5
+#define JIT_T  6
+#define JIT_U  7
+#define JIT_AX 8
+
+/* the constants after the code, a vector of 8 values each, at 32*k
+   from the start of them */
+#define JIT_E     0     /* SOFTENING*SOFTENING */
+#define JIT_G     1
+#define JIT_ONE   2
+#define JIT_THREE 3
+#define JIT_HALF  4     /* -0.5, see jit_rsqrt */
+#define JIT_CONSTANTS 5
+
+jit_kernel jit_kernels[JIT_ROWS + 1];
+
+static unsigned char * jit_code = NULL;
+
+/* the code being written and the vector length bit of the vex
+   prefix */
+struct jit {
+  unsigned char * code;
+  size_t used;
+  int l;
+};
+
+static void jit_byte (struct jit * j, unsigned int b) {
+  if (j->used < JIT_SIZE)
+    j->code[j->used] = b;
+
+  j->used += 1;
+}
+
+static void jit_u32 (struct jit * j, uint32_t u) {
+  int k;
+
+  for (k = 0; k < 4; k++)
+    jit_byte(j, (u >> 8*k) & 0xff);
+}
+
+static void jit_u64 (struct jit * j, uint64_t u) {
+  jit_u32(j, u & 0xffffffff);
+  jit_u32(j, u >> 32);
+}
+
+/* the three byte vex prefix and the opcode, reg goes in the modrm
+   reg field, v is the extra source and x, b extend the index and
+   base or register operand */
+static void jit_vex (struct jit * j, int map, int pp, int op,
+		     int reg, int v, int x, int b) {
+  jit_byte(j, 0xc4);
+  jit_byte(j, (!(reg & 8) << 7) | (!(x & 8) << 6) | (!(b & 8) << 5) | map);
+  jit_byte(j, ((~v & 15) << 3) | (j->l << 2) | pp);
+  jit_byte(j, op);
+}
+
+/* reg op= v, rm on registers */
+static void jit_vrr (struct jit * j, int map, int pp, int op,
+		     int reg, int v, int rm) {
+  jit_vex(j, map, pp, op, reg, v, 0, rm);
+  jit_byte(j, 0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+/* reg op= v, [base + 4*index + disp] with index -1 for none. base
+   is never rsp or r12, which would need another encoding. */
+static void jit_vrm (struct jit * j, int map, int pp, int op,
+		     int reg, int v, int base, int index, int32_t disp) {
+  jit_vex(j, map, pp, op, reg, v, index < 0 ? 0 : index, base);
+
+  if (index < 0) {
+    jit_byte(j, 0x80 | ((reg & 7) << 3) | (base & 7));
+  } else {
+    jit_byte(j, 0x84 | ((reg & 7) << 3));
+    jit_byte(j, 0x80 | ((index & 7) << 3) | (base & 7));
+  }
+
+  jit_u32(j, (uint32_t) disp);
+}
+
+/* the packed single instructions of the 0F map */
+static void jit_ps (struct jit * j, int op, int d, int a, int b) {
+  jit_vrr(j, JIT_0F, JIT_NP, op, d, a, b);
+}
+
+static void jit_ps_mem (struct jit * j, int op, int d, int a,
+			int base, int32_t disp) {
+  jit_vrm(j, JIT_0F, JIT_NP, op, d, a, base, -1, disp);
+}
+
+/* mov r, imm64 */
+static void jit_mov_imm (struct jit * j, int r, uint64_t u) {
+  jit_byte(j, 0x48 | ((r & 8) >> 3));
+  jit_byte(j, 0xb8 | (r & 7));
+  jit_u64(j, u);
+}
+
+/* inc r */
+static void jit_inc (struct jit * j, int r) {
+  jit_byte(j, 0x48 | ((r & 8) >> 3));
+  jit_byte(j, 0xff);
+  jit_byte(j, 0xc0 | (r & 7));
+}
+
+/* cmp a, b */
+static void jit_cmp (struct jit * j, int a, int b) {
+  jit_byte(j, 0x48 | ((b & 8) >> 1) | ((a & 8) >> 3));
+  jit_byte(j, 0x39);
+  jit_byte(j, 0xc0 | ((b & 7) << 3) | (a & 7));
+}
+
+/* a conditional jump with cc as in 0F 8x to target, returns the
+   position of its offset for jit_patch when target is not known */
+static size_t jit_jcc (struct jit * j, int cc, size_t target) {
+  size_t at;
+
+  jit_byte(j, 0x0f);
+  jit_byte(j, 0x80 | cc);
+
+  at = j->used;
+  jit_u32(j, (uint32_t) (target - (at + 4)));
+
+  return at;
+}
+
+/* points the jump whose offset is at at to here */
+static void jit_patch (struct jit * j, size_t at) {
+  uint32_t offset = j->used - (at + 4);
+
+  if (at + 4 <= JIT_SIZE)
+    memcpy(&j->code[at], &offset, 4);
+}
+
+/* S = 1/sqrt(S) in mode, leaves X, Y, M, RX, RY and the sums be.
+   rax points at the constants. */
+static void jit_rsqrt (struct jit * j, int mode) {
+  switch (mode) {
+  case RSQRT_EXACT:
+    jit_ps(j, JIT_VSQRTPS, JIT_T, 0, JIT_S);
+    jit_ps_mem(j, JIT_VMOVUPS_LOAD, JIT_S, 0, JIT_RAX,
+	       32*JIT_ONE);
+    jit_ps(j, JIT_VDIVPS, JIT_S, JIT_S, JIT_T);
+    break;
+
+  case RSQRT_NEWTON:
+    /* y (3 - s y^2)/2 as (-y/2) (s y^2 - 3), which is the same */
+    jit_ps(j, JIT_VRSQRTPS, JIT_T, 0, JIT_S);
+    jit_ps(j, JIT_VMULPS, JIT_U, JIT_T, JIT_T);
+    jit_ps(j, JIT_VMULPS, JIT_U, JIT_S, JIT_U);
+    jit_ps_mem(j, JIT_VSUBPS, JIT_U, JIT_U, JIT_RAX,
+	       32*JIT_THREE);
+    jit_ps_mem(j, JIT_VMULPS, JIT_T, JIT_T, JIT_RAX,
+	       32*JIT_HALF);
+    jit_ps(j, JIT_VMULPS, JIT_S, JIT_T, JIT_U);
+    break;
+
+  default:
+    jit_ps(j, JIT_VRSQRTPS, JIT_S, 0, JIT_S);
+  }
+}
+
+/* writes the kernel for rows blocks of width values, the constants
+   are at offset constants in the code */
+static void jit_kernel_write (struct jit * j, int rows, int width,
+			      int mode, int fma, int constants) {
+  int32_t block = 4*width;
+  int32_t pxi = 0, pyi = rows*block;
+  int32_t ax = 2*rows*block, ay = 3*rows*block;
+  size_t loop, done;
+  int r;
+
+  /* rdi px, rsi py, rdx m, rcx j0, r8 j1, r9 io and rax the
+     constants, all of them caller saved like every vector */
+  jit_mov_imm(j, JIT_RAX, (uintptr_t) (j->code + constants));
+
+  for (r = 0; r < rows; r++) {
+    jit_ps_mem(j, JIT_VMOVUPS_LOAD, JIT_AX + 2*r, 0, JIT_R9, ax + r*block);
+    jit_ps_mem(j, JIT_VMOVUPS_LOAD, JIT_AX + 2*r+1, 0, JIT_R9, ay + r*block);
+  }
+
+  jit_cmp(j, JIT_RCX, JIT_R8);
+  done = jit_jcc(j, 0x3, 0);       /* jae */
+
+  loop = j->used;
+
+  jit_vrm(j, JIT_0F38, JIT_66, JIT_VBROADCASTSS, JIT_X, 0,
+	  JIT_RDI, JIT_RCX, 0);
+  jit_vrm(j, JIT_0F38, JIT_66, JIT_VBROADCASTSS, JIT_Y, 0,
+	  JIT_RSI, JIT_RCX, 0);
+  jit_vrm(j, JIT_0F38, JIT_66, JIT_VBROADCASTSS, JIT_M, 0,
+	  JIT_RDX, JIT_RCX, 0);
+
+  for (r = 0; r < rows; r++) {
+    /* r = p[j] - p[i] */
+    jit_ps_mem(j, JIT_VSUBPS, JIT_RX, JIT_X, JIT_R9, pxi + r*block);
+    jit_ps_mem(j, JIT_VSUBPS, JIT_RY, JIT_Y, JIT_R9, pyi + r*block);
+
+    /* s = (r[0]*r[0] + r[1]*r[1]) + SOFTENING*SOFTENING */
+    jit_ps(j, JIT_VMULPS, JIT_S, JIT_RX, JIT_RX);
+
+    if (fma) {
+      jit_vrr(j, JIT_0F38, JIT_66, JIT_VFMADD231PS, JIT_S, JIT_RY, JIT_RY);
+    } else {
+      jit_ps(j, JIT_VMULPS, JIT_T, JIT_RY, JIT_RY);
+      jit_ps(j, JIT_VADDPS, JIT_S, JIT_S, JIT_T);
+    }
+
+    if (SOFTENING != value_literal(0.0))
+      jit_ps_mem(j, JIT_VADDPS, JIT_S, JIT_S, JIT_RAX, 32*JIT_E);
+
+    /* s = m[j]/sqrt(s*s*s) */
+    jit_ps(j, JIT_VMULPS, JIT_T, JIT_S, JIT_S);
+    jit_ps(j, JIT_VMULPS, JIT_S, JIT_S, JIT_T);
+
+    jit_rsqrt(j, mode);
+
+    jit_ps(j, JIT_VMULPS, JIT_S, JIT_S, JIT_M);
+
+    /* a += G*r*s */
+    if (GRAVITATIONAL_CONSTANT != value_literal(1.0)) {
+      jit_ps_mem(j, JIT_VMULPS, JIT_RX, JIT_RX, JIT_RAX, 32*JIT_G);
+      jit_ps_mem(j, JIT_VMULPS, JIT_RY, JIT_RY, JIT_RAX, 32*JIT_G);
+    }
+
+    if (fma) {
+      jit_vrr(j, JIT_0F38, JIT_66, JIT_VFMADD231PS,
+	      JIT_AX + 2*r, JIT_RX, JIT_S);
+      jit_vrr(j, JIT_0F38, JIT_66, JIT_VFMADD231PS,
+	      JIT_AX + 2*r+1, JIT_RY, JIT_S);
+    } else {
+      jit_ps(j, JIT_VMULPS, JIT_RX, JIT_RX, JIT_S);
+      jit_ps(j, JIT_VADDPS, JIT_AX + 2*r, JIT_AX + 2*r, JIT_RX);
+      jit_ps(j, JIT_VMULPS, JIT_RY, JIT_RY, JIT_S);
+      jit_ps(j, JIT_VADDPS, JIT_AX + 2*r+1, JIT_AX + 2*r+1, JIT_RY);
+    }
+  }
+
+  jit_inc(j, JIT_RCX);
+  jit_cmp(j, JIT_RCX, JIT_R8);
+  jit_jcc(j, 0x2, loop);           /* jb */
+
+  jit_patch(j, done);
+
+  for (r = 0; r < rows; r++) {
+    jit_ps_mem(j, JIT_VMOVUPS_STORE, JIT_AX + 2*r, 0, JIT_R9, ax + r*block);
+    jit_ps_mem(j, JIT_VMOVUPS_STORE, JIT_AX + 2*r+1, 0, JIT_R9, ay + r*block);
+  }
+
+  /* vzeroupper, ret */
+  jit_byte(j, 0xc5);
+  jit_byte(j, 0xf8);
+  jit_byte(j, 0x77);
+  jit_byte(j, 0xc3);
+}
+
+void jit_free (void) {
+  int r;
+
+  if (jit_code != NULL)
+    munmap(jit_code, JIT_SIZE);
+
+  jit_code = NULL;
+
+  for (r = 0; r <= JIT_ROWS; r++)
+    jit_kernels[r] = NULL;
+}
+
+int jit_init (int width, int mode) {
+  const char * jit = getenv("NBODY_JIT");
+  value * constant;
+  struct jit j;
+  int fma, r, k;
+  size_t at[JIT_ROWS + 1];
+  /* the constants go at the end, on cache lines of their own */
+  int constants = JIT_SIZE - 64*JIT_CONSTANTS;
+
+  jit_free();
+
+  if (jit != NULL && strcmp(jit, "off") == 0) {
+    printf("jit off\n");
+    return 0;
+  }
+
+  if ((width != 4 && width != 8) || !__builtin_cpu_supports("avx")) {
+    printf("jit has no kernels for this cpu, using C\n");
+    return 0;
+  }
+
+  fma = __builtin_cpu_supports("fma");
+
+  jit_code = mmap(NULL, JIT_SIZE, PROT_READ | PROT_WRITE,
+		  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (jit_code == MAP_FAILED) {
+    jit_code = NULL;
+    perror(__func__);
+    return 0;
+  }
+
+  j.code = jit_code;
+  j.used = 0;
+  j.l = width == 8;
+
+  for (r = 1; r <= JIT_ROWS; r++) {
+    /* kernels start on a cache line */
+    while (j.used % 64 != 0)
+      jit_byte(&j, 0xcc);
+
+    at[r] = j.used;
+    jit_kernel_write(&j, r, width, mode, fma, constants);
+  }
+
+  if (j.used > (size_t) constants) {
+    fprintf(stderr, "%s: kernels of %zu bytes do not fit\n",
+	    __func__, j.used);
+    jit_free();
+    return 0;
+  }
+
+  constant = (value *) (jit_code + constants);
+
+  for (k = 0; k < 8; k++) {
+    constant[8*JIT_E + k] = SOFTENING*SOFTENING;
+    constant[8*JIT_G + k] = GRAVITATIONAL_CONSTANT;
+    constant[8*JIT_ONE + k] = value_literal(1.0);
+    constant[8*JIT_THREE + k] = value_literal(3.0);
+    constant[8*JIT_HALF + k] = value_literal(-0.5);
+  }
+
+  if (mprotect(jit_code, JIT_SIZE, PROT_READ | PROT_EXEC) < 0) {
+    perror(__func__);
+    jit_free();
+    return 0;
+  }
+
+  for (r = 1; r <= JIT_ROWS; r++)
+    jit_kernels[r] = (jit_kernel) (jit_code + at[r]);
+
+  printf("jit %s%s, %d kernels, %zu bytes\n",
+	 width == 8 ? "avx" : "avx-128", fma ? " fma" : "",
+	 JIT_ROWS, j.used);
+
+  return 1;
+}
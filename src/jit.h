@@ -0,0 +1,44 @@
+#ifndef JIT_H
+#define JIT_H 1
+
+#include <stddef.h>
+
+#include "value.h"
+
+/*
+ * A small x86-64 code generator for the force loop of the simd
+ * kernel. At startup it writes one kernel for every number of
+ * blocks of particles i up to JIT_ROWS into executable memory,
+ * specialised on the vector width, on whether the cpu has FMA, on
+ * the rsqrt mode and on the constants, a softening of 0 leaves out
+ * its add and a G of 1 its multiplications.
+ *
+ * A kernel goes over the particles j0 up to j1 of px, py and m for
+ * rows blocks of width particles i. io holds, rows*width values
+ * each, the x and then the y positions of the particles i followed
+ * by their x and y accelerations, which the pulls are added to.
+ *
+ * Only this loop over j is generated, it is where nearly all the time
+ * of a step goes. The drift and the kicks stay in the C kernel, which
+ * copies every block of particles i into io and back out again.
+ *
+ * NBODY_JIT=off in the environment leaves the force loop to the C
+ * kernels, as does a cpu or width the generator does not know.
+ */
+#define JIT_ROWS 4
+
+typedef void (* jit_kernel) (const value * px, const value * py,
+			     const value * m, size_t j0, size_t j1,
+			     value * io);
+
+/* the kernels by number of rows, NULL when there are none */
+extern jit_kernel jit_kernels[JIT_ROWS + 1];
+
+/* frees the kernels */
+extern void jit_free (void);
+
+/* writes the kernels for vectors of width values and the given
+   rsqrt mode, returns 0 if it did not */
+extern int jit_init (int width, int mode);
+
+#endif /* JIT_H */
@@ -3,14 +3,70 @@
 
 #define NBODY_PRAGMA(x) _Pragma(#x)
 
+/*
+ * The team of the parallel region in the main loop lives for the
+ * whole simulation, everything else only uses orphaned worksharing
+ * inside it. Loops are statically scheduled so that the threads
+ * that first touched a range, see topology.h, and any two loops over
+ * the same range divide it the same way. A NOWAIT loop is followed
+ * by NBODY_OMP_BARRIER where the next one reads what others wrote,
+ * and that barrier is the spinning one from barrier.h rather than
+ * the runtime's.
+ */
 #ifdef _OPENMP
-#define NBODY_OMP_BARRIER  NBODY_PRAGMA(omp barrier)
-#define NBODY_OMP_MASTER   NBODY_PRAGMA(omp master)
-#define NBODY_OMP_PARALLEL NBODY_PRAGMA(omp parallel)
+#include <omp.h>
+
+#include "barrier.h"
+
+#define NBODY_OMP_BARRIER      barrier_wait();
+#define NBODY_OMP_FOR          NBODY_PRAGMA(omp for schedule(static))
+#define NBODY_OMP_FOR_NOWAIT   NBODY_PRAGMA(omp for schedule(static) nowait)
+#define NBODY_OMP_MASTER       NBODY_PRAGMA(omp master)
+#define NBODY_OMP_PARALLEL     NBODY_PRAGMA(omp parallel)
+#define NBODY_OMP_PARALLEL_FOR NBODY_PRAGMA(omp parallel for schedule(static))
+
+/* number of threads in the current team */
+static inline int nbody_omp_threads (void) {
+  return omp_get_num_threads();
+}
+
+/* index of the calling thread in the current team */
+static inline int nbody_omp_thread (void) {
+  return omp_get_thread_num();
+}
+
+/* number of threads the next parallel region will have */
+static inline int nbody_omp_max_threads (void) {
+  return omp_get_max_threads();
+}
+
+/* sets the number of threads of the next parallel regions */
+static inline void nbody_omp_set_threads (int threads) {
+  omp_set_num_threads(threads);
+}
 #else
 #define NBODY_OMP_BARRIER
+#define NBODY_OMP_FOR
+#define NBODY_OMP_FOR_NOWAIT
 #define NBODY_OMP_MASTER
 #define NBODY_OMP_PARALLEL
+#define NBODY_OMP_PARALLEL_FOR
+
+static inline int nbody_omp_threads (void) {
+  return 1;
+}
+
+static inline int nbody_omp_thread (void) {
+  return 0;
+}
+
+static inline int nbody_omp_max_threads (void) {
+  return 1;
+}
+
+static inline void nbody_omp_set_threads (int threads) {
+  (void) threads;
+}
 #endif /* _OPENMP */
 
 #endif /* NBODY_OPENMP_H */
@@ -1,20 +1,32 @@
 #include <errno.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 
 #include "align_malloc.h"
+#include "collide.h"
 #include "draw.h"
+#include "elastic.h"
+#include "escape.h"
 #include "initial-condition.h"
 #include "physics.h"
+#include "publish.h"
+#include "reorder.h"
 #include "rng.h"
+#ifdef PHYSICS_RSQRT
+#include "rsqrt.h"
+#endif
+#include "topology.h"
 
 #include "nbody-openmp.h"
 #include "nbody.h"
 
 static size_t n;
 
+static size_t * id;
+
 static value * px;
 static value * py;
 
@@ -33,53 +45,178 @@ static double timer (void) {
   return now.tv_sec + 1e-9*now.tv_nsec;
 }
 
+/* steps to take before looking at the outside world again, as many
+   as fit in BATCH_TIME at the last measured speed, but never past
+   the next reordering, collision or escape check or diagnostics */
+static unsigned int batch (unsigned long int counter, double step) {
+  unsigned int k = BATCH_MAX;
+
+  if (step > 0.0 && BATCH_TIME/step < BATCH_MAX)
+    k = BATCH_TIME/step < 1.0 ? 1 : BATCH_TIME/step;
+
+#if REORDER_INTERVAL
+  if (k > REORDER_INTERVAL - counter % REORDER_INTERVAL)
+    k = REORDER_INTERVAL - counter % REORDER_INTERVAL;
+#endif
+
+#if COLLISION_INTERVAL
+  if (k > COLLISION_INTERVAL - counter % COLLISION_INTERVAL)
+    k = COLLISION_INTERVAL - counter % COLLISION_INTERVAL;
+#endif
+
+#if ESCAPE_INTERVAL
+  if (k > ESCAPE_INTERVAL - counter % ESCAPE_INTERVAL)
+    k = ESCAPE_INTERVAL - counter % ESCAPE_INTERVAL;
+#endif
+
+#if DIAGNOSTICS_INTERVAL
+  if (k > DIAGNOSTICS_INTERVAL - counter % DIAGNOSTICS_INTERVAL)
+    k = DIAGNOSTICS_INTERVAL - counter % DIAGNOSTICS_INTERVAL;
+#endif
+
+  (void) counter;
+
+  return k;
+}
+
+/* the diagnostics of the step just taken, the energy drift is
+   relative to the first ones */
+static void diagnostics (unsigned long int counter, double * e0) {
+  double d[PHYSICS_DIAGNOSTICS];
+  double e;
+
+  physics_diagnostics(d);
+
+  e = d[PHYSICS_KINETIC] + d[PHYSICS_POTENTIAL];
+
+  if (*e0 == 0.0)
+    *e0 = e;
+
+  printf("%lu energy %.9g drift %.3g momentum %.9g %.9g "
+	 "angular momentum %.9g virial %.9g\n",
+	 counter, e, (e - *e0)/fabs(*e0),
+	 d[PHYSICS_MOMENTUM_X], d[PHYSICS_MOMENTUM_Y],
+	 d[PHYSICS_ANGULAR], d[PHYSICS_VIRIAL]);
+}
+
 static bool main_loop (void) {
   unsigned int app_state = 0;
   unsigned long int counter = 0;
+  unsigned int k = 1;
   double s, t;
+  double e0 = 0.0;
+  bool diagnosing = false;
+  bool resize = false;
+  size_t i;
 
   initial_condition(n, px, py, vx, vy, m);
 
+  for (i = 0; i < n; i++)
+    id[i] = i;
+
   s = 0.0;
 
-  NBODY_OMP_PARALLEL
-    do {
-      NBODY_OMP_MASTER
-	{
-	  t = timer();
-	}
+  /* the team is made anew whenever elastic.h asks for another size */
+  do {
+    /* collisions and escapes change the number of particles, every
+       thread keeps its own count and the master passes it on after
+       every batch */
+    NBODY_OMP_PARALLEL
+    {
+      size_t count = n;
+
+      do {
+#if COLLISION_INTERVAL
+	if ((counter % COLLISION_INTERVAL) == 0)
+	  count = collide_particles(count, id, px, py, vx, vy, m);
+#endif
+
+#if ESCAPE_INTERVAL
+	if ((counter % ESCAPE_INTERVAL) == 0)
+	  count = escape_particles(count, id, px, py, vx, vy, m);
+#endif
+
+#if REORDER_INTERVAL
+	if ((counter % REORDER_INTERVAL) == 0)
+	  reorder_particles(count, id, px, py, vx, vy, m);
+#endif
+
+	NBODY_OMP_MASTER
+	  {
+	    t = timer();
+	  }
+
+	physics_advance_n(k, dt, count, px, py, vx, vy, m);
+
+	NBODY_OMP_MASTER
+	  {
+	    t = timer() - t;
+	    s += t;
 
-      physics_advance(dt, n, px, py, vx, vy, m);
+	    if (draw_redraw()) {
+	      draw_particles(dt, count, id, px, py, vx, vy, m);
+	      app_state = draw_input(app_state, &dt);
+	    }
 
-      NBODY_OMP_MASTER
-	{
-	  t = timer() - t;
-	  s += t;
+	    if (publish_ready())
+	      publish_particles(counter, dt, count, id, px, py, vx, vy, m);
 
-	  if (draw_redraw()) {
-	    draw_particles(dt, n, px, py, vx, vy, m);
-	    app_state = draw_input(app_state, &dt);
+	    if ((counter + k)/1000LU != counter/1000LU)
+	      printf("%lu\n", counter + k);
+
+	    if (diagnosing)
+	      diagnostics(counter + k, &e0);
+
+	    elastic_adapt(count, k, t);
+	    resize = elastic_threads() != nbody_omp_threads();
+
+	    counter += k;
+	    k = batch(counter, t/k);
+	    n = count;
+
+#if DIAGNOSTICS_INTERVAL
+	    diagnosing = (counter + k) % DIAGNOSTICS_INTERVAL == 0 &&
+	      physics_diagnose();
+#endif
 	  }
+	NBODY_OMP_BARRIER
+	  ;
+      } while (! (app_state & EXIT) &&
+	       ! (app_state & RESET) &&
+	       ! resize);
+    }
 
-	  counter += 1;
+    if (resize) {
+      nbody_omp_set_threads(elastic_threads());
 
-	  if ((counter % 1000LU) == 0)
-	    printf("%lu\n", counter);
-	}
-      NBODY_OMP_BARRIER
-	;
-    } while (! (app_state & EXIT) &&
-	     ! (app_state & RESET));
+      topology_free();
+      topology_init();
+
+      resize = false;
+    }
+  } while (! (app_state & EXIT) &&
+	   ! (app_state & RESET));
 
   printf("%lu physics iterations over %f seconds, ratio %f\n",
   	 counter, s, counter/s);
 
+#if ESCAPE_INTERVAL
+  printf("%zu particles escaped\n", escape_count());
+#endif
+
+#ifdef PHYSICS_RSQRT
+  rsqrt_report(n, px, py);
+#endif
+
   return app_state & RESET;
 }
 
 int main (int argc, char * argv[]) {
   bool restart;
   unsigned long int particles_n;
+  unsigned long int seed;
+  size_t arena_page_size;
+  int threads;
 
   if (argc < 2) {
     particles_n = NUMBER_OF_PARTICLES;
@@ -94,8 +231,36 @@ int main (int argc, char * argv[]) {
     }
   }
 
+  if (argc < 3) {
+    seed = 0;
+  } else {
+    errno = 0;
+
+    seed = strtoul(argv[2], NULL, 0);
+
+    if (errno) {
+      perror(__func__);
+      exit(EXIT_FAILURE);
+    }
+  }
+
   n = particles_n;
 
+  /* threads are pinned before anything is placed */
+  topology_init();
+
+  arena_page_size =
+    align_arena_init(ARENA_ARRAYS*(n*sizeof(value) +
+				   ALIGN_BOUNDARY + ALLOC_PADDING));
+
+  if (arena_page_size == 0)
+    printf("no memory arena, using malloc\n");
+  else
+    printf("memory arena backed by %zu kB pages\n",
+	   arena_page_size/1024);
+
+  align_arena_placement(topology_place);
+
   px =
     align_padded_malloc(ALIGN_BOUNDARY, n*sizeof(value), ALLOC_PADDING);
   py =
@@ -109,31 +274,70 @@ int main (int argc, char * argv[]) {
   m  =
     align_padded_malloc(ALIGN_BOUNDARY, n*sizeof(value), ALLOC_PADDING);
 
+  id =
+    align_malloc(ALIGN_BOUNDARY, n*sizeof(size_t));
+
   if (px == NULL || py == NULL ||
-      vx == NULL || vy == NULL || m == NULL) {
+      vx == NULL || vy == NULL || m == NULL || id == NULL) {
     perror("main");
     exit(EXIT_FAILURE);
   }
 
+#ifdef PHYSICS_RSQRT
+  rsqrt_init(PHYSICS_RSQRT);
+#endif
+
   draw_init(SCREEN_WIDTH, SCREEN_HEIGHT, FRAME_RATE, n);
+
+  /* everything that keeps something per thread is set up for all
+     of them, see elastic.h */
+  publish_init(n);
+  reorder_init(n);
+  collide_init(n);
+  escape_init(n);
+
+  /* an autotuned physics may settle on fewer threads, they are
+     pinned anew for the team they then make up */
+  threads = nbody_omp_max_threads();
   physics_init(n);
+
+  if (nbody_omp_max_threads() != threads) {
+    topology_free();
+    topology_init();
+  }
+
+  elastic_init(threads);
+  rng_seed(seed);
   rng_init();
 
   do {
+    n = particles_n;
+
     draw_reset(n);
+    escape_reset();
     physics_reset(n);
+    publish_reset(n);
     restart = main_loop();
   } while (restart);
 
   rng_free();
+  elastic_free();
   physics_free();
+  escape_free();
+  collide_free();
+  reorder_free();
+  publish_free();
   draw_free();
 
+  align_free(id);
   align_free(m);
   align_free(vy);
   align_free(vx);
   align_free(py);
   align_free(px);
 
+  align_arena_free();
+  topology_free();
+
   exit(EXIT_SUCCESS);
 }
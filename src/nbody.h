@@ -8,6 +8,45 @@
 
 #define TIME_DELTA value_literal(1e-7)
 
+/* steps are taken in batches of up to BATCH_MAX lasting about
+   BATCH_TIME seconds, drawing, publishing and user input are only
+   looked at between batches */
+#define BATCH_TIME 2e-3
+
+#ifndef BATCH_MAX
+#define BATCH_MAX  1024
+#endif
+
+/* steps between sorting the particles along a space filling
+   curve, 0 disables */
+#ifndef REORDER_INTERVAL
+#define REORDER_INTERVAL 128
+#endif
+
+/* steps between merging colliding particles, see collide.h,
+   0 disables */
+#ifndef COLLISION_INTERVAL
+#define COLLISION_INTERVAL 0
+#endif
+
+/* steps between moving escaping particles out of the force loops,
+   see escape.h, 0 disables */
+#ifndef ESCAPE_INTERVAL
+#define ESCAPE_INTERVAL 0
+#endif
+
+/* steps between logging the energy drift, momentum, angular
+   momentum and virial, which the force loops add up along the way.
+   0 disables */
+#ifndef DIAGNOSTICS_INTERVAL
+#define DIAGNOSTICS_INTERVAL 0
+#endif
+
+/* number of n sized arrays the memory arena has room for, the
+   particles, the physics state and the reordering buffers are all
+   carved from it. anything that does not fit uses malloc. */
+#define ARENA_ARRAYS 32
+
 /* window */
 
 /* if 0 then the native values will be used */
@@ -0,0 +1,44 @@
+#ifndef PHYSICS_DIAGNOSE_H
+#define PHYSICS_DIAGNOSE_H 1
+
+#include "physics.h"
+
+/* set by physics_diagnose until the batch it asked for is done */
+extern int diagnose;
+
+/* per thread partial diagnostics, summed in thread order by
+   physics_diagnostics */
+extern double (* diagnosis)[PHYSICS_DIAGNOSTICS];
+
+/* adds the kinetic energy, momentum and angular momentum of a
+   particle to d */
+static inline void physics_diagnose_motion (double * d,
+					    double px, double py,
+					    double vx, double vy,
+					    double m) {
+  d[PHYSICS_KINETIC] += 0.5*m*(vx*vx + vy*vy);
+  d[PHYSICS_MOMENTUM_X] += m*vx;
+  d[PHYSICS_MOMENTUM_Y] += m*vy;
+  d[PHYSICS_ANGULAR] += m*(px*vy - py*vx);
+}
+
+/* adds the potential energy and virial of a particle, from sums
+   over j of m[j]/|r| and m[j] r^2/|r|^3 with softened |r|. every
+   pair is seen from both ends. */
+static inline void physics_diagnose_pull (double * d, double m,
+					  double phi, double w) {
+  double G = GRAVITATIONAL_CONSTANT;
+
+  d[PHYSICS_POTENTIAL] -= 0.5*G*m*phi;
+  d[PHYSICS_VIRIAL] -= 0.5*G*m*w;
+}
+
+/* takes out the pull of a particle on itself, for sums over j that
+   include i */
+static inline void physics_diagnose_self (double * d, double m) {
+  double G = GRAVITATIONAL_CONSTANT;
+
+  d[PHYSICS_POTENTIAL] += 0.5*G*m*m/(double) SOFTENING;
+}
+
+#endif /* PHYSICS_DIAGNOSE_H */
@@ -2,7 +2,26 @@
 #include "value.h"
 
 extern value half;
+extern value one;
+extern value three;
 extern value soft;
 
 value half = 0.5f;
+value one = 1.0f;
+value three = 3.0f;
 value soft = SOFTENING*SOFTENING;
+
+int physics_diagnose (void) {
+  /* the assembly has no diagnostics */
+  return 0;
+}
+
+void physics_advance_n (unsigned int k, value dt, size_t n,
+			value * px, value * py,
+			value * vx, value * vy,
+			value * m) {
+  unsigned int step;
+
+  for (step = 0; step < k; step++)
+    physics_advance(dt, n, px, py, vx, vy, m);
+}
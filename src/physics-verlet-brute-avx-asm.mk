@@ -1,10 +1,11 @@
 NASM = nasm
 
 CPPFLAGS += -DVECTOR_SIZE=2 -DALIGN_BOUNDARY=32 -DALLOC_PADDING=32
+CPPFLAGS += -DPHYSICS_RSQRT=RSQRT_ESTIMATE
 CFLAGS += -mavx
 
-OBJS += physics-asm.o physics-util.o
-DEPS += physics-util.d
+OBJS += physics-asm.o physics-util.o rsqrt.o
+DEPS += physics-util.d rsqrt.d
 
 physics-asm.o : physics-verlet-brute-avx-asm.s
 	$(NASM) -f elf64 $< -o $@
@@ -5,8 +5,12 @@ section	.text
 default rel
 
 extern half
+extern one
+extern three
 extern soft
 
+extern rsqrt_mode
+
 extern a0x
 extern a0y
 extern a1x
@@ -68,6 +72,11 @@ physics_advance:
 	cmp	rax, rdi
 	jl	.L1
 
+	;; the rsqrt_mode, and 3 and 1/2 for its newton step
+	mov	eax, [rsqrt_mode]
+	vbroadcastss	ymm8, [three]
+	vbroadcastss	ymm9, [half]
+
 	xor	r10, r10
 .L2:
 	;; xi, yi
@@ -102,8 +111,27 @@ ALIGN 16
 	vmulps	ymm10, ymm11, ymm11
 	vmulps	ymm11, ymm11, ymm10
 
-	;; s = 1/sqrt(s)
+	;; s = 1/sqrt(s), as in rsqrt.h
+	cmp	eax, 1
+	je	.L6
+	ja	.L7
+
 	vrsqrtps	ymm11, ymm11
+	jmp	.L8
+.L6:
+	;; y = rsqrt(s), s = y/2 (3 - s y^2)
+	vrsqrtps	ymm10, ymm11
+	vmulps	ymm11, ymm11, ymm10
+	vmulps	ymm11, ymm11, ymm10
+	vsubps	ymm11, ymm8, ymm11
+	vmulps	ymm10, ymm10, ymm9
+	vmulps	ymm11, ymm11, ymm10
+	jmp	.L8
+.L7:
+	vsqrtps	ymm11, ymm11
+	vbroadcastss	ymm10, [one]
+	vdivps	ymm11, ymm10, ymm11
+.L8:
 
 	;; mj *= s
 	vmulps	ymm12, ymm11, ymm12
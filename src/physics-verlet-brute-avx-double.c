@@ -0,0 +1,218 @@
+#include <immintrin.h>
+
+#include "nbody-openmp.h"
+#include "physics-verlet-brute-double-util.h"
+
+static const double G = GRAVITATIONAL_CONSTANT;
+
+/*
+ * The avx kernel in double precision throughout, four particles to
+ * a block and a full square root and division for every pair. It
+ * is the reference the mixed precision kernel is measured against.
+ */
+
+/* accelerations of the block of particles starting at i due to the
+   particles j0 up to j1, and the sums over j of the diagnostics
+   when po and wo are given */
+static inline void physics_block (size_t i, size_t j0, size_t j1,
+				  const value * m,
+				  __m256d * axo, __m256d * ayo,
+				  __m256d * po, __m256d * wo) {
+  __m256d g = _mm256_set1_pd(G);
+  __m256d e = _mm256_set1_pd((double) SOFTENING*SOFTENING);
+
+  __m256d pxi = _mm256_load_pd(&dpx[i]);
+  __m256d pyi = _mm256_load_pd(&dpy[i]);
+
+  __m256d axi = _mm256_setzero_pd();
+  __m256d ayi = _mm256_setzero_pd();
+
+  __m256d phi = _mm256_setzero_pd();
+  __m256d wi = _mm256_setzero_pd();
+
+  size_t j;
+
+  for (j = j0; j < j1; j++) {
+    __m256d rx, ry;
+    __m256d s, s0;
+
+    __m256d pxj = _mm256_broadcast_sd(&dpx[j]);
+    __m256d pyj = _mm256_broadcast_sd(&dpy[j]);
+
+    __m256d mj = _mm256_set1_pd(m[j]);
+
+    rx = _mm256_sub_pd(pxj, pxi);
+    ry = _mm256_sub_pd(pyj, pyi);
+
+    /* s = m[j]/|r|^3 */
+    s0 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(rx, rx),
+				     _mm256_mul_pd(ry, ry)), e);
+    s = _mm256_div_pd(mj, _mm256_mul_pd(s0, _mm256_sqrt_pd(s0)));
+
+    axi = _mm256_add_pd(axi, _mm256_mul_pd(_mm256_mul_pd(g, rx), s));
+    ayi = _mm256_add_pd(ayi, _mm256_mul_pd(_mm256_mul_pd(g, ry), s));
+
+    /* m[j]/|r| and m[j] r^2/|r|^3 */
+    if (po != NULL) {
+      phi = _mm256_add_pd(phi, _mm256_mul_pd(s0, s));
+      wi = _mm256_add_pd(wi, _mm256_mul_pd(_mm256_sub_pd(s0, e), s));
+    }
+  }
+
+  *axo = axi;
+  *ayo = ayi;
+
+  if (po != NULL) {
+    *po = phi;
+    *wo = wi;
+  }
+}
+
+/* a single step, reads the accelerations a0 and writes a1, and
+   the diagnostics of this thread when diag is set */
+static void physics_step (double dt, size_t n, const value * m,
+			  double * a0x, double * a0y,
+			  double * a1x, double * a1y,
+			  int diag) {
+  double sums[PHYSICS_DIAGNOSTICS] = {0.0};
+  size_t i, massive;
+
+  __m256d d = _mm256_set1_pd(dt);
+  __m256d h = _mm256_set1_pd(0.5*dt);
+
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < n; i += 4) {
+    __m256d dx, dy;
+
+    /* px[i] += (vx[i] + 0.5*a0x[i]*dt)*dt; */
+    dx = _mm256_add_pd(_mm256_mul_pd(h, _mm256_load_pd(&a0x[i])),
+		       _mm256_load_pd(&dvx[i]));
+    dy = _mm256_add_pd(_mm256_mul_pd(h, _mm256_load_pd(&a0y[i])),
+		       _mm256_load_pd(&dvy[i]));
+
+    _mm256_store_pd(&dpx[i], _mm256_add_pd(_mm256_mul_pd(dx, d),
+					   _mm256_load_pd(&dpx[i])));
+    _mm256_store_pd(&dpy[i], _mm256_add_pd(_mm256_mul_pd(dy, d),
+					   _mm256_load_pd(&dpy[i])));
+  }
+
+  /* forces need every position */
+  NBODY_OMP_BARRIER
+
+  /* only the massive particles pull, see reorder.h */
+  massive = physics_massive(n, m);
+
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < n; i += 4) {
+    __m256d axi, ayi, po, wo;
+
+    if (diag) {
+      double p[4], w[4];
+      size_t l;
+
+      physics_block(i, 0, massive, m, &axi, &ayi, &po, &wo);
+
+      _mm256_storeu_pd(p, po);
+      _mm256_storeu_pd(w, wo);
+
+      for (l = 0; l < 4; l++)
+	physics_diagnose_pull(sums, m[i + l], p[l], w[l]);
+    } else {
+      physics_block(i, 0, massive, m, &axi, &ayi, NULL, NULL);
+    }
+
+    _mm256_store_pd(&a1x[i], axi);
+    _mm256_store_pd(&a1y[i], ayi);
+  }
+
+  /* scheduled like the forces, so every thread only reads the
+     accelerations it wrote itself */
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < n; i += 4) {
+    __m256d dvxi, dvyi;
+
+    /* vx[i] += 0.5*(a0x[i]+a1x[i])*dt; */
+    dvxi = _mm256_mul_pd(h, _mm256_add_pd(_mm256_load_pd(&a0x[i]),
+					  _mm256_load_pd(&a1x[i])));
+    dvyi = _mm256_mul_pd(h, _mm256_add_pd(_mm256_load_pd(&a0y[i]),
+					  _mm256_load_pd(&a1y[i])));
+
+    _mm256_store_pd(&dvx[i], _mm256_add_pd(dvxi, _mm256_load_pd(&dvx[i])));
+    _mm256_store_pd(&dvy[i], _mm256_add_pd(dvyi, _mm256_load_pd(&dvy[i])));
+
+    if (diag) {
+      size_t l;
+
+      for (l = i; l < i + 4; l++) {
+	physics_diagnose_motion(sums, dpx[l], dpy[l], dvx[l], dvy[l], m[l]);
+	physics_diagnose_self(sums, m[l]);
+      }
+    }
+  }
+
+  if (diag)
+    for (i = 0; i < PHYSICS_DIAGNOSTICS; i++)
+      diagnosis[nbody_omp_thread()][i] = sums[i];
+
+  /* the next step moves particles the forces may still be reading */
+  NBODY_OMP_BARRIER
+}
+
+void physics_advance (value dt, size_t n,
+		      value * px, value * py,
+		      value * vx, value * vy,
+		      value * m) {
+  physics_advance_n(1, dt, n, px, py, vx, vy, m);
+}
+
+void physics_advance_n (unsigned int k, value dt, size_t n,
+			value * px, value * py,
+			value * vx, value * vy,
+			value * m) {
+  /* every thread swaps its own copy of the accelerations between
+     steps, the shared ones are only swapped once at the end */
+  double * b0x;
+  double * b0y;
+  double * b1x;
+  double * b1y;
+  unsigned int step;
+
+  physics_load(n, px, py, vx, vy);
+
+  b0x = a0x;
+  b0y = a0y;
+  b1x = a1x;
+  b1y = a1y;
+
+  for (step = 0; step < k; step++) {
+    double * tx;
+    double * ty;
+
+    physics_step(dt, n, m, b0x, b0y, b1x, b1y,
+		 diagnose && step == k-1);
+
+    tx = b0x;
+    b0x = b1x;
+    b1x = tx;
+
+    ty = b0y;
+    b0y = b1y;
+    b1y = ty;
+  }
+
+  NBODY_OMP_MASTER
+  {
+    if (k & 1)
+      physics_swap();
+
+    diagnose = 0;
+  }
+
+  physics_store(n, px, py, vx, vy);
+}
+
+int physics_diagnose (void) {
+  diagnose = 1;
+
+  return 1;
+}
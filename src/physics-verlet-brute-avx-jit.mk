@@ -0,0 +1,6 @@
+include physics-verlet-brute-avx-openmp.mk
+
+CPPFLAGS += -DPHYSICS_JIT
+
+OBJS += jit.o
+DEPS += jit.d
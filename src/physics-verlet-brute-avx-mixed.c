@@ -0,0 +1,270 @@
+#include <immintrin.h>
+
+#include "nbody-openmp.h"
+#include "physics-verlet-brute-double-util.h"
+#include "rsqrt.h"
+
+/* particles j summed up in single precision before their pull goes
+   into the double precision sums */
+#ifndef PHYSICS_MIXED_TILE
+#define PHYSICS_MIXED_TILE 64
+#endif
+
+static const value G = GRAVITATIONAL_CONSTANT;
+
+/*
+ * The avx kernel in mixed precision. Positions, velocities and the
+ * integration are in double, the pairs are evaluated in single
+ * precision eight at a time. Every block of i works with positions
+ * relative to its first particle, so close pairs lose no digits to
+ * their distance from the origin, and the pulls are added up in
+ * single precision over tiles of j only, the tiles themselves are
+ * summed in double. The reciprocal square root takes a newton step
+ * unless NBODY_RSQRT says otherwise, see rsqrt.h.
+ */
+
+/* eight positions starting at i relative to c, in single precision */
+static inline __m256 physics_offset (const double * p, size_t i,
+				     __m256d c) {
+  __m128 lo = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_load_pd(&p[i]), c));
+  __m128 hi = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_load_pd(&p[i + 4]), c));
+
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+/* adds the eight lanes of v to the double precision sums d */
+static inline void physics_widen (__m256d * d, __m256 v) {
+  d[0] = _mm256_add_pd(d[0], _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+  d[1] = _mm256_add_pd(d[1], _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+}
+
+/* accelerations of the block of particles starting at i due to the
+   particles j0 up to j1, and the sums over j of the diagnostics
+   when po and wo are given. mode is the rsqrt_mode to use. */
+static inline void physics_block (size_t i, size_t j0, size_t j1,
+				  const value * m, int mode,
+				  __m256d * axo, __m256d * ayo,
+				  __m256d * po, __m256d * wo) {
+  __m256 g = _mm256_set1_ps(G);
+  __m256 e = _mm256_set1_ps(SOFTENING*SOFTENING);
+
+  double cx = dpx[i];
+  double cy = dpy[i];
+
+  __m256 pxi = physics_offset(dpx, i, _mm256_set1_pd(cx));
+  __m256 pyi = physics_offset(dpy, i, _mm256_set1_pd(cy));
+
+  size_t t, j;
+
+  axo[0] = axo[1] = _mm256_setzero_pd();
+  ayo[0] = ayo[1] = _mm256_setzero_pd();
+
+  if (po != NULL) {
+    po[0] = po[1] = _mm256_setzero_pd();
+    wo[0] = wo[1] = _mm256_setzero_pd();
+  }
+
+  for (t = j0; t < j1; t += PHYSICS_MIXED_TILE) {
+    size_t t1 = t + PHYSICS_MIXED_TILE < j1 ? t + PHYSICS_MIXED_TILE : j1;
+
+    __m256 axi = _mm256_setzero_ps();
+    __m256 ayi = _mm256_setzero_ps();
+
+    __m256 phi = _mm256_setzero_ps();
+    __m256 wi = _mm256_setzero_ps();
+
+    for (j = t; j < t1; j++) {
+      __m256 rx, ry;
+      __m256 s, s0, s3;
+
+      __m256 pxj = _mm256_set1_ps(dpx[j] - cx);
+      __m256 pyj = _mm256_set1_ps(dpy[j] - cy);
+
+      __m256 mj = _mm256_broadcast_ss(&m[j]);
+
+      rx = _mm256_sub_ps(pxj, pxi);
+      ry = _mm256_sub_ps(pyj, pyi);
+
+      s0 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rx, rx),
+				       _mm256_mul_ps(ry, ry)), e);
+      s3 = _mm256_mul_ps(s0, _mm256_mul_ps(s0, s0));
+
+      s = _mm256_mul_ps(rsqrt_avx(s3, mode), mj);
+
+      axi = _mm256_add_ps(axi, _mm256_mul_ps(_mm256_mul_ps(g, rx), s));
+      ayi = _mm256_add_ps(ayi, _mm256_mul_ps(_mm256_mul_ps(g, ry), s));
+
+      /* m[j]/|r| and m[j] r^2/|r|^3, never from the 12 bit
+	 estimate alone */
+      if (po != NULL) {
+	if (mode == RSQRT_ESTIMATE)
+	  s = _mm256_mul_ps(rsqrt_avx(s3, RSQRT_NEWTON), mj);
+
+	phi = _mm256_add_ps(phi, _mm256_mul_ps(s0, s));
+	wi = _mm256_add_ps(wi, _mm256_mul_ps(_mm256_sub_ps(s0, e), s));
+      }
+    }
+
+    physics_widen(axo, axi);
+    physics_widen(ayo, ayi);
+
+    if (po != NULL) {
+      physics_widen(po, phi);
+      physics_widen(wo, wi);
+    }
+  }
+}
+
+/* a single step, reads the accelerations a0 and writes a1, and
+   the diagnostics of this thread when diag is set */
+static void physics_step (double dt, size_t n, const value * m,
+			  double * a0x, double * a0y,
+			  double * a1x, double * a1y,
+			  int diag) {
+  double sums[PHYSICS_DIAGNOSTICS] = {0.0};
+  int mode = rsqrt_mode;
+  size_t i, l, massive;
+
+  __m256d d = _mm256_set1_pd(dt);
+  __m256d h = _mm256_set1_pd(0.5*dt);
+
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < n; i += 8) {
+    for (l = i; l < i + 8; l += 4) {
+      __m256d dx, dy;
+
+      /* px[i] += (vx[i] + 0.5*a0x[i]*dt)*dt; */
+      dx = _mm256_add_pd(_mm256_mul_pd(h, _mm256_load_pd(&a0x[l])),
+			 _mm256_load_pd(&dvx[l]));
+      dy = _mm256_add_pd(_mm256_mul_pd(h, _mm256_load_pd(&a0y[l])),
+			 _mm256_load_pd(&dvy[l]));
+
+      _mm256_store_pd(&dpx[l], _mm256_add_pd(_mm256_mul_pd(dx, d),
+					     _mm256_load_pd(&dpx[l])));
+      _mm256_store_pd(&dpy[l], _mm256_add_pd(_mm256_mul_pd(dy, d),
+					     _mm256_load_pd(&dpy[l])));
+    }
+  }
+
+  /* forces need every position */
+  NBODY_OMP_BARRIER
+
+  /* only the massive particles pull, see reorder.h */
+  massive = physics_massive(n, m);
+
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < n; i += 8) {
+    __m256d axi[2], ayi[2], po[2], wo[2];
+
+    if (diag) {
+      double p[8], w[8];
+
+      physics_block(i, 0, massive, m, mode, axi, ayi, po, wo);
+
+      _mm256_storeu_pd(&p[0], po[0]);
+      _mm256_storeu_pd(&p[4], po[1]);
+      _mm256_storeu_pd(&w[0], wo[0]);
+      _mm256_storeu_pd(&w[4], wo[1]);
+
+      for (l = 0; l < 8; l++)
+	physics_diagnose_pull(sums, m[i + l], p[l], w[l]);
+    } else {
+      physics_block(i, 0, massive, m, mode, axi, ayi, NULL, NULL);
+    }
+
+    _mm256_store_pd(&a1x[i], axi[0]);
+    _mm256_store_pd(&a1x[i + 4], axi[1]);
+    _mm256_store_pd(&a1y[i], ayi[0]);
+    _mm256_store_pd(&a1y[i + 4], ayi[1]);
+  }
+
+  /* scheduled like the forces, so every thread only reads the
+     accelerations it wrote itself */
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < n; i += 8) {
+    for (l = i; l < i + 8; l += 4) {
+      __m256d dvxi, dvyi;
+
+      /* vx[i] += 0.5*(a0x[i]+a1x[i])*dt; */
+      dvxi = _mm256_mul_pd(h, _mm256_add_pd(_mm256_load_pd(&a0x[l]),
+					    _mm256_load_pd(&a1x[l])));
+      dvyi = _mm256_mul_pd(h, _mm256_add_pd(_mm256_load_pd(&a0y[l]),
+					    _mm256_load_pd(&a1y[l])));
+
+      _mm256_store_pd(&dvx[l], _mm256_add_pd(dvxi, _mm256_load_pd(&dvx[l])));
+      _mm256_store_pd(&dvy[l], _mm256_add_pd(dvyi, _mm256_load_pd(&dvy[l])));
+    }
+
+    if (diag)
+      for (l = i; l < i + 8; l++) {
+	physics_diagnose_motion(sums, dpx[l], dpy[l], dvx[l], dvy[l], m[l]);
+	physics_diagnose_self(sums, m[l]);
+      }
+  }
+
+  if (diag)
+    for (i = 0; i < PHYSICS_DIAGNOSTICS; i++)
+      diagnosis[nbody_omp_thread()][i] = sums[i];
+
+  /* the next step moves particles the forces may still be reading */
+  NBODY_OMP_BARRIER
+}
+
+void physics_advance (value dt, size_t n,
+		      value * px, value * py,
+		      value * vx, value * vy,
+		      value * m) {
+  physics_advance_n(1, dt, n, px, py, vx, vy, m);
+}
+
+void physics_advance_n (unsigned int k, value dt, size_t n,
+			value * px, value * py,
+			value * vx, value * vy,
+			value * m) {
+  /* every thread swaps its own copy of the accelerations between
+     steps, the shared ones are only swapped once at the end */
+  double * b0x;
+  double * b0y;
+  double * b1x;
+  double * b1y;
+  unsigned int step;
+
+  physics_load(n, px, py, vx, vy);
+
+  b0x = a0x;
+  b0y = a0y;
+  b1x = a1x;
+  b1y = a1y;
+
+  for (step = 0; step < k; step++) {
+    double * tx;
+    double * ty;
+
+    physics_step(dt, n, m, b0x, b0y, b1x, b1y,
+		 diagnose && step == k-1);
+
+    tx = b0x;
+    b0x = b1x;
+    b1x = tx;
+
+    ty = b0y;
+    b0y = b1y;
+    b1y = ty;
+  }
+
+  NBODY_OMP_MASTER
+  {
+    if (k & 1)
+      physics_swap();
+
+    diagnose = 0;
+  }
+
+  physics_store(n, px, py, vx, vy);
+}
+
+int physics_diagnose (void) {
+  diagnose = 1;
+
+  return 1;
+}
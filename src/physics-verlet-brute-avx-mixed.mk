@@ -0,0 +1,11 @@
+# positions and velocities are kept in double precision, see draw-verify.c
+CPPFLAGS += -DVECTOR_SIZE=2 -DALIGN_BOUNDARY=32 -DALLOC_PADDING=32 -DPHYSICS_DOUBLE
+CPPFLAGS += -DPHYSICS_RSQRT=RSQRT_NEWTON
+CFLAGS += -mavx -Wno-unknown-pragmas
+
+OBJS += physics-verlet-brute-double-util.o rsqrt.o
+DEPS += physics-verlet-brute-double-util.d rsqrt.d
+
+OMPFLAGS = -fopenmp
+CFLAGS  += $(OMPFLAGS)
+LDFLAGS += $(OMPFLAGS)
@@ -0,0 +1 @@
+physics-verlet-brute-simd.c
\ No newline at end of file
@@ -1,5 +1,6 @@
 CPPFLAGS += -DVECTOR_SIZE=2 -DALIGN_BOUNDARY=32 -DALLOC_PADDING=32
+CPPFLAGS += -DPHYSICS_RSQRT=RSQRT_ESTIMATE -DSIMD_WIDTH=8 -DPHYSICS_TUNE
 CFLAGS += -mavx -Wno-unknown-pragmas
 
-OBJS += physics-util.o
-DEPS += physics-util.d
+OBJS += physics-util.o rsqrt.o tune.o
+DEPS += physics-util.d rsqrt.d tune.d
@@ -0,0 +1 @@
+physics-verlet-brute-avx512.c
\ No newline at end of file
@@ -0,0 +1,5 @@
+include physics-verlet-brute-avx512.mk
+
+OMPFLAGS = -fopenmp
+CFLAGS  += $(OMPFLAGS)
+LDFLAGS += $(OMPFLAGS)
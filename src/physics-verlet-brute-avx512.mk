@@ -0,0 +1,6 @@
+CPPFLAGS += -DVECTOR_SIZE=2 -DALIGN_BOUNDARY=64 -DALLOC_PADDING=64
+CPPFLAGS += -DPHYSICS_RSQRT=RSQRT_ESTIMATE -DSIMD_WIDTH=16 -DPHYSICS_TUNE
+CFLAGS += -mavx512f -Wno-unknown-pragmas
+
+OBJS += physics-util.o rsqrt.o tune.o
+DEPS += physics-util.d rsqrt.d tune.d
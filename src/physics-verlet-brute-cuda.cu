@@ -25,6 +25,8 @@ static value * dvy;
 
 static value * dm;
 
+static size_t * dorder;
+
 static inline void physics_swap (void) {
   value * tx;
   value * ty;
@@ -173,25 +175,76 @@ void physics_advance_velocities (value dt, int n,
   physics_advance_velocities_inner(dt, n, a0y, a1y, vy);
 }
 
+__global__
+void physics_gather (int n, const size_t * order,
+		     const value * a0, value * a1) {
+  int i = blockIdx.x*blockDim.x + threadIdx.x;
+
+  if (i >= n)
+    return;
+
+  a1[i] = a0[order[i]];
+}
+
+__global__
+void physics_merge_weights (int n, const size_t * into, const value * m,
+			    value * ax, value * ay) {
+  int i = blockIdx.x*blockDim.x + threadIdx.x;
+  size_t j;
+  value M;
+
+  if (i >= n || into[i] == (size_t) n)
+    return;
+
+  j = into[i];
+  M = m[i] + m[j];
+
+  if (M > 0) {
+    ax[i] = (m[i]*ax[i] + m[j]*ax[j])/M;
+    ay[i] = (m[i]*ay[i] + m[j]*ay[j])/M;
+  }
+}
+
 void physics_advance (value dt, size_t n,
 		      value * px, value * py,
 		      value * vx, value * vy,
 		      value * m) {
+  physics_advance_n(1, dt, n, px, py, vx, vy, m);
+}
+
+void physics_advance_n (unsigned int k, value dt, size_t n,
+			value * px, value * py,
+			value * vx, value * vy,
+			value * m) {
   int blockSize  = BLOCK_SIZE;
   int gridSize   = (n + blockSize-1)/blockSize;
   int sharedSize = blockSize*sizeof(value3);
+  unsigned int step;
 
   physics_load_memory(n, px, py, vx, vy, m);  
 
-  physics_advance_positions<<<gridSize, blockSize>>>(dt, n, dvx, dvy, a0x, a0y, dpx, dpy);
-  physics_calculate_forces<<<gridSize, blockSize, sharedSize>>>(n, dpx, dpy, dm, a1x, a1y);
-  physics_advance_velocities<<<gridSize, blockSize>>>(dt, n, a0x, a0y, a1x, a1y, dvx, dvy);
+  /* the state stays on the device, the kernels of consecutive steps
+     are queued back to back */
+  for (step = 0; step < k; step++) {
+    physics_advance_positions<<<gridSize, blockSize>>>(dt, n, dvx, dvy, a0x, a0y, dpx, dpy);
+    physics_calculate_forces<<<gridSize, blockSize, sharedSize>>>(n, dpx, dpy, dm, a1x, a1y);
+    physics_advance_velocities<<<gridSize, blockSize>>>(dt, n, a0x, a0y, a1x, a1y, dvx, dvy);
 
-  physics_swap();
+    physics_swap();
+  }
 
   physics_offload_memory(n, px, py, vx, vy);
 }
 
+int physics_diagnose (void) {
+  /* the force loops have no diagnostics */
+  return 0;
+}
+
+void physics_diagnostics (double * d) {
+  (void) d;
+}
+
 void physics_free (void) {
   cudaFree(a0x);
   cudaFree(a0y);
@@ -207,6 +260,8 @@ void physics_free (void) {
 
   cudaFree(dm);
 
+  cudaFree(dorder);
+
   cudaDeviceReset();
 }
 
@@ -224,6 +279,33 @@ void physics_init (size_t n) {
   cudaMalloc(&dvy, n*sizeof(value));
 
   cudaMalloc(&dm, n*sizeof(value));
+
+  cudaMalloc(&dorder, n*sizeof(size_t));
+}
+
+void physics_merge (size_t n, const size_t * into, const value * m) {
+  int blockSize  = BLOCK_SIZE;
+  int gridSize   = (n + blockSize-1)/blockSize;
+
+  cudaMemcpy(dorder, into, n*sizeof(size_t), cudaMemcpyHostToDevice);
+  cudaMemcpy(dm, m, n*sizeof(value), cudaMemcpyHostToDevice);
+
+  physics_merge_weights<<<gridSize, blockSize>>>(n, dorder, dm, a0x, a0y);
+}
+
+void physics_reorder (size_t n, const size_t * order) {
+  int blockSize  = BLOCK_SIZE;
+  int gridSize   = (n + blockSize-1)/blockSize;
+
+  cudaMemcpy(dorder, order, n*sizeof(size_t), cudaMemcpyHostToDevice);
+
+  physics_gather<<<gridSize, blockSize>>>(n, dorder, a0x, a1x);
+  physics_gather<<<gridSize, blockSize>>>(n, dorder, a0y, a1y);
+
+  physics_swap();
+
+  /* the host arrays were reordered too */
+  memory_loaded = 0;
 }
 
 void physics_reset (size_t n) {
@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "align_malloc.h"
+#include "nbody-openmp.h"
+
+#include "physics-verlet-brute-double-util.h"
+
+double * dpx = NULL;
+double * dpy = NULL;
+
+double * dvx = NULL;
+double * dvy = NULL;
+
+double * a0x = NULL;
+double * a0y = NULL;
+
+double * a1x = NULL;
+double * a1y = NULL;
+
+int diagnose = 0;
+double (* diagnosis)[PHYSICS_DIAGNOSTICS] = NULL;
+
+/* set once the state holds the particles */
+static int loaded;
+
+size_t physics_massive (size_t n, const value * m) {
+  while (n > 0 && m[n-1] == value_literal(0.0))
+    n -= 1;
+
+  return n;
+}
+
+void physics_swap (void) {
+  double * tx;
+  double * ty;
+
+  tx = a0x;
+  a0x = a1x;
+  a1x = tx;
+
+  ty = a0y;
+  a0y = a1y;
+  a1y = ty;
+}
+
+void physics_load (size_t n,
+		   const value * px, const value * py,
+		   const value * vx, const value * vy) {
+  size_t i;
+
+  if (loaded)
+    return;
+
+  NBODY_OMP_FOR
+  for (i = 0; i < n + PHYSICS_DOUBLE_BLOCK; i++) {
+    if (i < n) {
+      dpx[i] = px[i];
+      dpy[i] = py[i];
+      dvx[i] = vx[i];
+      dvy[i] = vy[i];
+    } else {
+      dpx[i] = dpy[i] = dvx[i] = dvy[i] = 0.0;
+    }
+
+    a0x[i] = a0y[i] = 0.0;
+    a1x[i] = a1y[i] = 0.0;
+  }
+
+  NBODY_OMP_MASTER
+  loaded = 1;
+}
+
+void physics_store (size_t n,
+		    value * px, value * py,
+		    value * vx, value * vy) {
+  size_t i;
+
+  /* the particles are read as soon as this returns */
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++) {
+    px[i] = dpx[i];
+    py[i] = dpy[i];
+    vx[i] = dvx[i];
+    vy[i] = dvy[i];
+  }
+}
+
+void physics_diagnostics (double * d) {
+  int t, threads = nbody_omp_max_threads();
+  int i;
+
+  for (i = 0; i < PHYSICS_DIAGNOSTICS; i++)
+    d[i] = 0.0;
+
+  for (t = 0; t < threads; t++)
+    for (i = 0; i < PHYSICS_DIAGNOSTICS; i++)
+      d[i] += diagnosis[t][i];
+}
+
+void physics_free (void) {
+  free(diagnosis);
+
+  align_free(a1y);
+  align_free(a1x);
+  align_free(a0y);
+  align_free(a0x);
+  align_free(dvy);
+  align_free(dvx);
+  align_free(dpy);
+  align_free(dpx);
+
+  dpx = NULL;
+  dpy = NULL;
+  dvx = NULL;
+  dvy = NULL;
+
+  a0x = NULL;
+  a0y = NULL;
+  a1x = NULL;
+  a1y = NULL;
+
+  diagnosis = NULL;
+}
+
+void physics_init (size_t n) {
+  size_t size = n*sizeof(double);
+  size_t padding = PHYSICS_DOUBLE_BLOCK*sizeof(double);
+
+  dpx = align_padded_malloc(ALIGN_BOUNDARY, size, padding);
+  dpy = align_padded_malloc(ALIGN_BOUNDARY, size, padding);
+  dvx = align_padded_malloc(ALIGN_BOUNDARY, size, padding);
+  dvy = align_padded_malloc(ALIGN_BOUNDARY, size, padding);
+
+  a0x = align_padded_malloc(ALIGN_BOUNDARY, size, padding);
+  a0y = align_padded_malloc(ALIGN_BOUNDARY, size, padding);
+  a1x = align_padded_malloc(ALIGN_BOUNDARY, size, padding);
+  a1y = align_padded_malloc(ALIGN_BOUNDARY, size, padding);
+
+  diagnosis =
+    calloc(nbody_omp_max_threads(), sizeof(*diagnosis));
+
+  if (dpx == NULL || dpy == NULL || dvx == NULL || dvy == NULL ||
+      a0x == NULL || a0y == NULL || a1x == NULL || a1y == NULL ||
+      diagnosis == NULL) {
+    perror(__func__);
+    exit(EXIT_FAILURE);
+  }
+
+  physics_reset(n);
+}
+
+void physics_merge (size_t n, const size_t * into, const value * m) {
+  size_t i;
+
+  /* nothing to fold before the first load */
+  if (!loaded)
+    return;
+
+  /* the same center of mass and momentum as the particles get, but
+     from the state in double */
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++) {
+    size_t j = into[i];
+    double M;
+
+    if (j == n)
+      continue;
+
+    M = (double) m[i] + m[j];
+
+    if (M > 0.0) {
+      dpx[i] = (m[i]*dpx[i] + m[j]*dpx[j])/M;
+      dpy[i] = (m[i]*dpy[i] + m[j]*dpy[j])/M;
+      dvx[i] = (m[i]*dvx[i] + m[j]*dvx[j])/M;
+      dvy[i] = (m[i]*dvy[i] + m[j]*dvy[j])/M;
+
+      a0x[i] = (m[i]*a0x[i] + m[j]*a0x[j])/M;
+      a0y[i] = (m[i]*a0y[i] + m[j]*a0y[j])/M;
+    }
+  }
+}
+
+/* moves x[order[i]] to x[i] through a1x, which is scratch between
+   steps, and zeroes the padding past n */
+static void physics_permute (double ** x, size_t n, const size_t * order) {
+  size_t i;
+
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++)
+    a1x[i] = (*x)[order[i]];
+
+  NBODY_OMP_MASTER
+  {
+    double * t = *x;
+
+    *x = a1x;
+    a1x = t;
+
+    for (i = n; i < n + PHYSICS_DOUBLE_BLOCK; i++)
+      (*x)[i] = 0.0;
+  }
+
+  NBODY_OMP_BARRIER
+    ;
+}
+
+void physics_reorder (size_t n, const size_t * order) {
+  if (!loaded)
+    return;
+
+  physics_permute(&dpx, n, order);
+  physics_permute(&dpy, n, order);
+  physics_permute(&dvx, n, order);
+  physics_permute(&dvy, n, order);
+  physics_permute(&a0x, n, order);
+  physics_permute(&a0y, n, order);
+}
+
+void physics_reset (size_t n) {
+  /* the particles are only there once the main loop starts */
+  loaded = 0;
+
+  (void) n;
+}
@@ -0,0 +1,52 @@
+#ifndef PHYSICS_VERLET_BRUTE_DOUBLE_UTIL_H
+#define PHYSICS_VERLET_BRUTE_DOUBLE_UTIL_H 1
+
+#include "nbody-openmp.h"
+#include "physics-diagnose.h"
+#include "physics.h"
+
+/*
+ * The double precision backends keep positions, velocities and
+ * accelerations of their own between calls and only write the
+ * particles back, rounded to value, at the end of every batch. The
+ * state is loaded again from the particles after a reset, while
+ * merges and reorders are applied to it directly so nothing is
+ * lost there.
+ *
+ * Every array has room for PHYSICS_DOUBLE_BLOCK particles more than
+ * asked for, the padding is kept at zero so whole blocks can be
+ * loaded past n.
+ */
+#define PHYSICS_DOUBLE_BLOCK 8
+
+extern double * dpx;
+extern double * dpy;
+
+extern double * dvx;
+extern double * dvy;
+
+extern double * a0x;
+extern double * a0y;
+
+extern double * a1x;
+extern double * a1y;
+
+/* number of particles up to and including the last one with mass,
+   see physics-verlet-brute-util.h */
+extern size_t physics_massive (size_t n, const value * m);
+
+extern void physics_swap (void);
+
+/* loads the state from the particles unless it is up to date, must
+   be called by every thread */
+extern void physics_load (size_t n,
+			  const value * px, const value * py,
+			  const value * vx, const value * vy);
+
+/* writes the positions and velocities back to the particles, must
+   be called by every thread */
+extern void physics_store (size_t n,
+			   value * px, value * py,
+			   value * vx, value * vy);
+
+#endif /* PHYSICS_VERLET_BRUTE_DOUBLE_UTIL_H */
@@ -2,11 +2,12 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include <immintrin.h>
-
 #include "align_malloc.h"
+#include "nbody-openmp.h"
 
 #include "physics-verlet-brute-hybrid.h"
+#include "rsqrt.h"
+#include "simd.h"
 
 static const value G = GRAVITATIONAL_CONSTANT;
 
@@ -22,30 +23,33 @@ void physics_cpu_advance_positions (value dt, size_t n,
   size_t i;
   size_t cpu_n = CPU_N;
 
-  __m256 d = _mm256_set1_ps(dt);
-  __m256 h = _mm256_set1_ps(value_literal(0.5)*dt);
+  simd d = simd_set1(dt);
+  simd h = simd_set1(value_literal(0.5)*dt);
 
-#pragma omp for
-  for (i = 0; i < cpu_n; i += 8) {
-    __m256 dx;
-    __m256 dy;
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < cpu_n; i += SIMD_WIDTH) {
+    simd dx;
+    simd dy;
 
     /* px[i] += */
     /*   (vx[i] + value_literal(0.5)*a0x[i]*dt)*dt; */
     /* py[i] += */
     /*   (vy[i] + value_literal(0.5)*a0y[i]*dt)*dt; */
-    dx = _mm256_mul_ps(h, *(__m256 *) &a0x[i]);
-    dy = _mm256_mul_ps(h, *(__m256 *) &a0y[i]);
+    dx = simd_mul(h, simd_load(&a0x[i]));
+    dy = simd_mul(h, simd_load(&a0y[i]));
 
-    dx = _mm256_add_ps(dx, *(__m256 *) &vx[i]);
-    dy = _mm256_add_ps(dy, *(__m256 *) &vy[i]);
+    dx = simd_add(dx, simd_load(&vx[i]));
+    dy = simd_add(dy, simd_load(&vy[i]));
 
-    dx = _mm256_mul_ps(dx, d);
-    dy = _mm256_mul_ps(dy, d);
+    dx = simd_mul(dx, d);
+    dy = simd_mul(dy, d);
 
-    _mm256_store_ps(&px[i], _mm256_add_ps(dx, *(__m256 *) &px[i]));
-    _mm256_store_ps(&py[i], _mm256_add_ps(dy, *(__m256 *) &py[i]));
+    simd_store(&px[i], simd_add(dx, simd_load(&px[i])));
+    simd_store(&py[i], simd_add(dy, simd_load(&py[i])));
   }
+
+  /* the positions are copied to the device next */
+  NBODY_OMP_BARRIER
 }
 
 void physics_cpu_calculate_forces (size_t n,
@@ -53,60 +57,61 @@ void physics_cpu_calculate_forces (size_t n,
 				   const value * m) {
   size_t i, j;
   size_t cpu_n = CPU_N;
+  int mode = rsqrt_mode;
 
-  __m256 g = _mm256_set1_ps(G);
-  __m256 e = _mm256_set1_ps(SOFTENING*SOFTENING);
+  simd g = simd_set1(G);
+  simd e = simd_set1(SOFTENING*SOFTENING);
 
-#pragma omp for private(i, j)
-  for (i = 0; i < cpu_n; i += 8) {
-    __m256 pxi = _mm256_load_ps(&px[i]);
-    __m256 pyi = _mm256_load_ps(&py[i]);
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < cpu_n; i += SIMD_WIDTH) {
+    simd pxi = simd_load(&px[i]);
+    simd pyi = simd_load(&py[i]);
 
-    __m256 axi = _mm256_setzero_ps();
-    __m256 ayi = _mm256_setzero_ps();
+    simd axi = simd_zero();
+    simd ayi = simd_zero();
 
     for (j = 0; j < n; j++) {
-      __m256 ax, ay;
-      __m256 rx, ry;
-      __m256 s;
+      simd ax, ay;
+      simd rx, ry;
+      simd s;
 
-      __m256 pxj = _mm256_broadcast_ss(&px[j]);
-      __m256 pyj = _mm256_broadcast_ss(&py[j]);
+      simd pxj = simd_broadcast(&px[j]);
+      simd pyj = simd_broadcast(&py[j]);
 
-      __m256 mj = _mm256_broadcast_ss(&m[j]);
+      simd mj = simd_broadcast(&m[j]);
 
       /* r[0] = px[j] - px[i]; */
       /* r[1] = py[j] - py[i]; */
-      rx = _mm256_sub_ps(pxj, pxi);
-      ry = _mm256_sub_ps(pyj, pyi);
+      rx = simd_sub(pxj, pxi);
+      ry = simd_sub(pyj, pyi);
 
       /* s = (r[0]*r[0] + r[1]*r[1]) + SOFTENING*SOFTENING; */
-      s = _mm256_add_ps(_mm256_mul_ps(rx, rx),
-			_mm256_mul_ps(ry, ry));
-      s = _mm256_add_ps(s, e);
+      s = simd_add(simd_mul(rx, rx),
+		   simd_mul(ry, ry));
+      s = simd_add(s, e);
 
       /* s = s*s*s; */
-      s = _mm256_mul_ps(s, _mm256_mul_ps(s, s));
+      s = simd_mul(s, simd_mul(s, s));
 
       /* s = value_literal(1.0)/sqrtv(s); */
-      s = _mm256_rsqrt_ps(s);
+      s = simd_rsqrt(s, mode);
 
       /* s = s*m[j]; */
-      s = _mm256_mul_ps(s, mj);
+      s = simd_mul(s, mj);
 
       /* a[0] = G*r[0]*s; */
       /* a[1] = G*r[1]*s; */
-      ax = _mm256_mul_ps(_mm256_mul_ps(g, rx), s);
-      ay = _mm256_mul_ps(_mm256_mul_ps(g, ry), s);
+      ax = simd_mul(simd_mul(g, rx), s);
+      ay = simd_mul(simd_mul(g, ry), s);
 
       /* a1x[i] += a[0]; */
       /* a1y[i] += a[1]; */
-      axi = _mm256_add_ps(axi, ax);
-      ayi = _mm256_add_ps(ayi, ay);
+      axi = simd_add(axi, ax);
+      ayi = simd_add(ayi, ay);
     }
 
-    _mm256_store_ps(&a1x[i], axi);
-    _mm256_store_ps(&a1y[i], ayi);
+    simd_store(&a1x[i], axi);
+    simd_store(&a1y[i], ayi);
   }
 }
 
@@ -115,22 +120,27 @@ void physics_cpu_advance_velocities (value dt, size_t n,
   size_t i;
   size_t cpu_n = CPU_N;
 
-  __m256 h = _mm256_set1_ps(value_literal(0.5)*dt);
+  simd h = simd_set1(value_literal(0.5)*dt);
 
-#pragma omp for
-  for (i = 0; i < cpu_n; i += 8) {
-    __m256 axi = _mm256_load_ps(&a0x[i]);
-    __m256 ayi = _mm256_load_ps(&a0y[i]);
+  /* scheduled like the forces, so every thread only reads the
+     accelerations it wrote itself */
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < cpu_n; i += SIMD_WIDTH) {
+    simd axi = simd_load(&a0x[i]);
+    simd ayi = simd_load(&a0y[i]);
 
-    __m256 dvx, dvy;
+    simd dvx, dvy;
     /* vx[i] += value_literal(0.5)*(a0x[i]+a1x[i])*dt; */
     /* vy[i] += value_literal(0.5)*(a0y[i]+a1y[i])*dt; */
-    dvx = _mm256_mul_ps(h, _mm256_add_ps(axi, *(__m256 *) &a1x[i]));
-    dvy = _mm256_mul_ps(h, _mm256_add_ps(ayi, *(__m256 *) &a1y[i]));
+    dvx = simd_mul(h, simd_add(axi, simd_load(&a1x[i])));
+    dvy = simd_mul(h, simd_add(ayi, simd_load(&a1y[i])));
 
-    _mm256_store_ps(&vx[i], _mm256_add_ps(dvx, *(__m256 *) &vx[i]));
-    _mm256_store_ps(&vy[i], _mm256_add_ps(dvy, *(__m256 *) &vy[i]));
+    simd_store(&vx[i], simd_add(dvx, simd_load(&vx[i])));
+    simd_store(&vy[i], simd_add(dvy, simd_load(&vy[i])));
   }
+
+  /* the accelerations are swapped next */
+  NBODY_OMP_BARRIER
 }
 
 void physics_cpu_swap (void) {
@@ -174,6 +184,60 @@ void physics_cpu_init (size_t n) {
   }
 }
 
+/* ax, ay hold the accelerations computed on the gpu, the cpu range
+   is filled in, the mergers are weighted in and the cpu range is
+   given back */
+void physics_cpu_merge (size_t n, const size_t * into,
+			const value * m,
+			value * ax, value * ay) {
+  size_t i;
+  size_t cpu_n = CPU_N;
+
+  memcpy(ax, a0x, cpu_n*sizeof(value));
+  memcpy(ay, a0y, cpu_n*sizeof(value));
+
+  for (i = 0; i < n; i++) {
+    size_t j = into[i];
+    value M;
+
+    if (j == n)
+      continue;
+
+    M = m[i] + m[j];
+
+    if (M > value_literal(0.0)) {
+      ax[i] = (m[i]*ax[i] + m[j]*ax[j])/M;
+      ay[i] = (m[i]*ay[i] + m[j]*ay[j])/M;
+    }
+  }
+
+  memcpy(a0x, ax, cpu_n*sizeof(value));
+  memcpy(a0y, ay, cpu_n*sizeof(value));
+}
+
+/* ax, ay hold the accelerations of n particles computed on the gpu,
+   the cpu range is filled in and the kept ones are reordered in
+   place */
+void physics_cpu_reorder (size_t n, size_t kept,
+			  const size_t * order,
+			  value * ax, value * ay) {
+  size_t i;
+  size_t cpu_n = CPU_N;
+
+  memcpy(ax, a0x, cpu_n*sizeof(value));
+  memcpy(ay, a0y, cpu_n*sizeof(value));
+
+  for (i = 0; i < kept; i++) {
+    a1x[i] = ax[order[i]];
+    a1y[i] = ay[order[i]];
+  }
+
+  memcpy(ax, a1x, kept*sizeof(value));
+  memcpy(ay, a1y, kept*sizeof(value));
+
+  physics_cpu_swap();
+}
+
 void physics_cpu_reset (size_t n) {
   memset(a0x, 0, n*sizeof(value));
   memset(a0y, 0, n*sizeof(value));
@@ -1,3 +1,6 @@
+#include <stdio.h>
+#include <stdlib.h>
+
 #include <cuda.h>
 
 extern "C" {
@@ -11,6 +14,9 @@ static const value E = SOFTENING*SOFTENING;
 
 static int memory_loaded;
 
+/* particles the accelerations are laid out for */
+static size_t physics_n;
+
 static value * a0x;
 static value * a0y;
 
@@ -210,6 +216,31 @@ void physics_advance (value dt, size_t n,
   }
 }
 
+void physics_advance_n (unsigned int k, value dt, size_t n,
+			value * px, value * py,
+			value * vx, value * vy,
+			value * m) {
+  unsigned int step;
+
+  for (step = 0; step < k; step++) {
+    /* the master swaps the accelerations at the end of a step */
+    if (step > 0) {
+#pragma omp barrier
+    }
+
+    physics_advance(dt, n, px, py, vx, vy, m);
+  }
+}
+
+int physics_diagnose (void) {
+  /* the force loops have no diagnostics */
+  return 0;
+}
+
+void physics_diagnostics (double * d) {
+  (void) d;
+}
+
 void physics_free (void) {
   physics_cpu_free();
 
@@ -248,7 +279,65 @@ void physics_init (size_t n) {
   cudaMalloc(&dm, n*sizeof(value));
 }
 
+void physics_merge (size_t n, const size_t * into, const value * m) {
+#pragma omp master
+  {
+    value * ax = (value *) malloc(n*sizeof(value));
+    value * ay = (value *) malloc(n*sizeof(value));
+
+    if (ax == NULL || ay == NULL) {
+      perror(__func__);
+      exit(EXIT_FAILURE);
+    }
+
+    cudaMemcpy(ax, a0x, n*sizeof(value), cudaMemcpyDeviceToHost);
+    cudaMemcpy(ay, a0y, n*sizeof(value), cudaMemcpyDeviceToHost);
+
+    physics_cpu_merge(n, into, m, ax, ay);
+
+    cudaMemcpy(a0x, ax, n*sizeof(value), cudaMemcpyHostToDevice);
+    cudaMemcpy(a0y, ay, n*sizeof(value), cudaMemcpyHostToDevice);
+
+    free(ay);
+    free(ax);
+  }
+#pragma omp barrier
+}
+
+void physics_reorder (size_t n, const size_t * order) {
+#pragma omp master
+  {
+    /* the split between cpu and gpu follows the old count */
+    value * ax = (value *) malloc(physics_n*sizeof(value));
+    value * ay = (value *) malloc(physics_n*sizeof(value));
+
+    if (ax == NULL || ay == NULL) {
+      perror(__func__);
+      exit(EXIT_FAILURE);
+    }
+
+    cudaMemcpy(ax, a0x, physics_n*sizeof(value), cudaMemcpyDeviceToHost);
+    cudaMemcpy(ay, a0y, physics_n*sizeof(value), cudaMemcpyDeviceToHost);
+
+    physics_cpu_reorder(physics_n, n, order, ax, ay);
+
+    cudaMemcpy(a0x, ax, n*sizeof(value), cudaMemcpyHostToDevice);
+    cudaMemcpy(a0y, ay, n*sizeof(value), cudaMemcpyHostToDevice);
+
+    free(ay);
+    free(ax);
+
+    physics_n = n;
+
+    /* the host arrays were reordered too */
+    memory_loaded = 0;
+  }
+#pragma omp barrier
+}
+
 void physics_reset (size_t n) {
+  physics_n = n;
+
   physics_cpu_reset(n);
 
   cudaMemset(a0x, 0, n*sizeof(value));
@@ -12,6 +12,12 @@
 
 extern void physics_cpu_free (void);
 extern void physics_cpu_init (size_t n);
+extern void physics_cpu_merge (size_t n, const size_t * into,
+			       const value * m,
+			       value * ax, value * ay);
+extern void physics_cpu_reorder (size_t n, size_t kept,
+				 const size_t * order,
+				 value * ax, value * ay);
 extern void physics_cpu_reset (size_t n);
 extern void physics_cpu_swap (void);
 
@@ -1,12 +1,13 @@
 include cuda.mk
 
 CPPFLAGS += -DVECTOR_SIZE=2 -DALIGN_BOUNDARY=32 -DALLOC_PADDING=32
+CPPFLAGS += -DPHYSICS_RSQRT=RSQRT_ESTIMATE -DSIMD_WIDTH=8
 CFLAGS += -fopenmp
 
 LDFLAGS += -Xcompiler=-fopenmp
 
-OBJS += physics-verlet-brute-hybrid.o 
-DEPS += physics-verlet-brute-hybrid.du
+OBJS += physics-verlet-brute-hybrid.o rsqrt.o
+DEPS += physics-verlet-brute-hybrid.du rsqrt.d
 
 physics-verlet-brute-hybrid.o : physics-verlet-brute-hybrid.cu
 	$(NVCC) $(NVCCFLAGS) -c -o $@ $<
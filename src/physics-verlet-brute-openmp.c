@@ -1,57 +1,138 @@
 #include <math.h>
 
+#include "nbody-openmp.h"
 #include "physics-verlet-brute-util.h"
 
 static const value G = GRAVITATIONAL_CONSTANT;
 
+/* a single step, reads the accelerations a0 and writes a1, and
+   the diagnostics of this thread when diag is set */
+static void physics_step (value dt, size_t n,
+			  value * px, value * py,
+			  value * vx, value * vy,
+			  value * m,
+			  value * a0x, value * a0y,
+			  value * a1x, value * a1y,
+			  int diag) {
+  double sums[PHYSICS_DIAGNOSTICS] = {0.0};
+  size_t i, j, massive = physics_massive(n, m);
+
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < n; i++) {
+    px[i] +=
+      (vx[i] + value_literal(0.5)*a0x[i]*dt)*dt;
+    py[i] +=
+      (vy[i] + value_literal(0.5)*a0y[i]*dt)*dt;
+
+    a1x[i] = value_literal(0.0);
+    a1y[i] = value_literal(0.0);
+  }
+
+  /* forces need every position */
+  NBODY_OMP_BARRIER
+
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < n; i++) {
+    value phi = value_literal(0.0);
+    value w = value_literal(0.0);
+
+    /* only the massive particles pull, see reorder.h */
+    for (j = 0; j < massive; j++) {
+      value a[VECTOR_SIZE], r[VECTOR_SIZE];
+      value s, s0;
+
+      r[0] = px[j] - px[i];
+      r[1] = py[j] - py[i];
+
+      s0 = (r[0]*r[0] + r[1]*r[1]) + SOFTENING*SOFTENING;
+      s = s0*s0*s0;
+      s = value_literal(1.0)/sqrtv(s);
+
+      s = s*m[j];
+
+      a[0] = G*r[0]*s;
+      a[1] = G*r[1]*s;
+
+      a1x[i] += a[0];
+      a1y[i] += a[1];
+
+      if (diag) {
+	phi += s0*s;
+	w += (s0 - SOFTENING*SOFTENING)*s;
+      }
+    }
+
+    if (diag)
+      physics_diagnose_pull(sums, m[i], phi, w);
+  }
+
+  /* scheduled like the forces, so every thread only reads the
+     accelerations it wrote itself */
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < n; i++) {
+    vx[i] += value_literal(0.5)*(a0x[i]+a1x[i])*dt;
+    vy[i] += value_literal(0.5)*(a0y[i]+a1y[i])*dt;
+
+    if (diag) {
+      physics_diagnose_motion(sums, px[i], py[i], vx[i], vy[i], m[i]);
+      physics_diagnose_self(sums, m[i]);
+    }
+  }
+
+  if (diag)
+    for (i = 0; i < PHYSICS_DIAGNOSTICS; i++)
+      diagnosis[nbody_omp_thread()][i] = sums[i];
+
+  /* the next step moves particles the forces may still be reading */
+  NBODY_OMP_BARRIER
+}
+
 void physics_advance (value dt, size_t n,
 		      value * px, value * py,
 		      value * vx, value * vy,
 		      value * m) {
-  size_t i, j;
+  physics_advance_n(1, dt, n, px, py, vx, vy, m);
+}
 
-#pragma omp parallel private(i, j)
-  {
-#pragma omp for
-    for (i = 0; i < n; i++) {
-      px[i] +=
-	(vx[i] + value_literal(0.5)*a0x[i]*dt)*dt;
-      py[i] +=
-	(vy[i] + value_literal(0.5)*a0y[i]*dt)*dt;
-
-      a1x[i] = value_literal(0.0);
-      a1y[i] = value_literal(0.0);
-    }
+void physics_advance_n (unsigned int k, value dt, size_t n,
+			value * px, value * py,
+			value * vx, value * vy,
+			value * m) {
+  /* every thread swaps its own copy of the accelerations between
+     steps, the shared ones are only swapped once at the end */
+  value * b0x = a0x;
+  value * b0y = a0y;
+  value * b1x = a1x;
+  value * b1y = a1y;
+  unsigned int step;
 
-#pragma omp for
-    for (i = 0; i < n; i++) {
-      for (j = 0; j < n; j++) {
-	value a[VECTOR_SIZE], r[VECTOR_SIZE];
-	value s;
+  for (step = 0; step < k; step++) {
+    value * tx;
+    value * ty;
 
-	r[0] = px[j] - px[i];
-	r[1] = py[j] - py[i];
+    physics_step(dt, n, px, py, vx, vy, m, b0x, b0y, b1x, b1y,
+		 diagnose && step == k-1);
 
-	s = (r[0]*r[0] + r[1]*r[1]) + SOFTENING*SOFTENING;
-	s = s*s*s;
-	s = value_literal(1.0)/sqrtv(s);
+    tx = b0x;
+    b0x = b1x;
+    b1x = tx;
 
-	s = s*m[j];
+    ty = b0y;
+    b0y = b1y;
+    b1y = ty;
+  }
 
-	a[0] = G*r[0]*s;
-	a[1] = G*r[1]*s;
+  NBODY_OMP_MASTER
+  {
+    if (k & 1)
+      physics_swap();
 
-	a1x[i] += a[0];
-	a1y[i] += a[1];
-      }
-    }
+    diagnose = 0;
+  }
+}
 
-#pragma omp for
-    for (i = 0; i < n; i++) {
-      vx[i] += value_literal(0.5)*(a0x[i]+a1x[i])*dt;
-      vy[i] += value_literal(0.5)*(a0y[i]+a1y[i])*dt;
-    }
-  } /* #pragma omp parallel */
+int physics_diagnose (void) {
+  diagnose = 1;
 
-  physics_swap();
+  return 1;
 }
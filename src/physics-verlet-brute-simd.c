@@ -0,0 +1,765 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "align_malloc.h"
+#include "elastic.h"
+#ifdef PHYSICS_JIT
+#include "jit.h"
+#endif
+#include "nbody-openmp.h"
+#include "physics-verlet-brute-util.h"
+#include "rsqrt.h"
+#include "simd.h"
+#include "tune.h"
+
+/* most blocks of particles i that share the particles j they are
+   pulled by, see physics_block */
+#define PHYSICS_ROWS 4
+
+#if PHYSICS_ROWS > TUNE_BLOCK_MAX
+#error "PHYSICS_ROWS must be at most TUNE_BLOCK_MAX"
+#endif
+
+#if defined(PHYSICS_JIT) && JIT_ROWS < PHYSICS_ROWS
+#error "JIT_ROWS must be at least PHYSICS_ROWS"
+#endif
+
+/* most particles physics_few steps, see physics_few_n for the
+   kernels there are */
+#define PHYSICS_FEW        32
+#define PHYSICS_FEW_BLOCKS ((PHYSICS_FEW + SIMD_WIDTH-1)/SIMD_WIDTH)
+
+/* particles the candidates of physics_tune are timed on, and steps
+   the fastest of is taken for each after one to warm up */
+#define PHYSICS_TUNE_SAMPLE 4096
+#define PHYSICS_TUNE_STEPS  4
+
+static const value G = GRAVITATIONAL_CONSTANT;
+
+/* the tiles of j and the blocks of i the kernel runs with, untiled
+   and a block at a time until physics_tune picks them */
+static struct tune tuned = {0, 1, 1};
+
+/*
+ * The SSE, AVX and AVX-512 kernels, written once against simd.h and
+ * compiled at the SIMD_WIDTH the .mk of each sets. Blocks of
+ * SIMD_WIDTH particles i are stepped together, each particle j is
+ * broadcast into every lane. The reciprocal square root is in the
+ * rsqrt mode chosen at startup, see rsqrt.h.
+ *
+ * Up to PHYSICS_ROWS blocks share the loads of every j, and the j
+ * may be taken in tiles that stay in cache while every block of i
+ * goes over them. Neither changes the order any lane sums in, so
+ * the results are the same whatever physics_tune picks.
+ */
+
+/* accelerations of the rows blocks of particles starting at i due
+   to the particles j0 up to j1, added to axo and ayo, and the sums
+   over j of the diagnostics added to po and wo when they are given.
+   mode is the rsqrt_mode to use. rows is a constant wherever this
+   is inlined, so every block keeps its sums in registers and shares
+   the particles j loaded for it. */
+static inline void physics_block (size_t i, unsigned int rows,
+				  size_t j0, size_t j1,
+				  const value * px, const value * py,
+				  const value * m, int mode,
+				  simd * axo, simd * ayo,
+				  simd * po, simd * wo) {
+  simd g = simd_set1(G);
+  simd e = simd_set1(SOFTENING*SOFTENING);
+
+  simd pxi[PHYSICS_ROWS], pyi[PHYSICS_ROWS];
+  simd axi[PHYSICS_ROWS], ayi[PHYSICS_ROWS];
+  simd phi[PHYSICS_ROWS], wi[PHYSICS_ROWS];
+
+  size_t j;
+  unsigned int r;
+
+  for (r = 0; r < rows; r++) {
+    pxi[r] = simd_load(&px[i + r*SIMD_WIDTH]);
+    pyi[r] = simd_load(&py[i + r*SIMD_WIDTH]);
+
+    axi[r] = axo[r];
+    ayi[r] = ayo[r];
+
+    phi[r] = po != NULL ? po[r] : simd_zero();
+    wi[r] = po != NULL ? wo[r] : simd_zero();
+  }
+
+  for (j = j0; j < j1; j++) {
+    simd pxj = simd_broadcast(&px[j]);
+    simd pyj = simd_broadcast(&py[j]);
+
+    simd mj = simd_broadcast(&m[j]);
+
+    for (r = 0; r < rows; r++) {
+      simd ax, ay;
+      simd rx, ry;
+      simd s, s0, s3;
+
+      /* r[0] = px[j] - px[i]; */
+      /* r[1] = py[j] - py[i]; */
+      rx = simd_sub(pxj, pxi[r]);
+      ry = simd_sub(pyj, pyi[r]);
+
+      /* s = (r[0]*r[0] + r[1]*r[1]) + SOFTENING*SOFTENING; */
+      s = simd_add(simd_mul(rx, rx),
+		   simd_mul(ry, ry));
+      s = simd_add(s, e);
+      s0 = s;
+
+      /* s = s*s*s; */
+      s = simd_mul(s, simd_mul(s, s));
+      s3 = s;
+
+      /* s = value_literal(1.0)/sqrtv(s); */
+      s = simd_rsqrt(s, mode);
+
+      /* s = s*m[j]; */
+      s = simd_mul(s, mj);
+
+      /* a[0] = G*r[0]*s; */
+      /* a[1] = G*r[1]*s; */
+      ax = simd_mul(simd_mul(g, rx), s);
+      ay = simd_mul(simd_mul(g, ry), s);
+
+      /* a1x[i] += a[0]; */
+      /* a1y[i] += a[1]; */
+      axi[r] = simd_add(axi[r], ax);
+      ayi[r] = simd_add(ayi[r], ay);
+
+      /* m[j]/|r| and m[j] r^2/|r|^3, never from the 12 bit estimate
+	 alone */
+      if (po != NULL) {
+	simd y = simd_rsqrt(s3, mode == RSQRT_ESTIMATE ? RSQRT_NEWTON : mode);
+
+	s = simd_mul(y, mj);
+
+	phi[r] = simd_add(phi[r], simd_mul(s0, s));
+	wi[r] = simd_add(wi[r], simd_mul(simd_sub(s0, e), s));
+      }
+    }
+  }
+
+  for (r = 0; r < rows; r++) {
+    axo[r] = axi[r];
+    ayo[r] = ayi[r];
+
+    if (po != NULL) {
+      po[r] = phi[r];
+      wo[r] = wi[r];
+    }
+  }
+}
+
+#ifdef PHYSICS_JIT
+/* physics_block without the diagnostics in the kernel jit_init
+   wrote for rows, see jit.h */
+static void physics_jit (size_t i, unsigned int rows,
+			 size_t j0, size_t j1,
+			 const value * px, const value * py,
+			 const value * m,
+			 simd * axo, simd * ayo) {
+  value io[4*PHYSICS_ROWS*SIMD_WIDTH];
+  size_t block = rows*SIMD_WIDTH;
+  unsigned int r;
+
+  for (r = 0; r < rows; r++) {
+    simd_storeu(&io[r*SIMD_WIDTH], simd_load(&px[i + r*SIMD_WIDTH]));
+    simd_storeu(&io[block + r*SIMD_WIDTH], simd_load(&py[i + r*SIMD_WIDTH]));
+    simd_storeu(&io[2*block + r*SIMD_WIDTH], axo[r]);
+    simd_storeu(&io[3*block + r*SIMD_WIDTH], ayo[r]);
+  }
+
+  jit_kernels[rows](px, py, m, j0, j1, io);
+
+  for (r = 0; r < rows; r++) {
+    axo[r] = simd_loadu(&io[2*block + r*SIMD_WIDTH]);
+    ayo[r] = simd_loadu(&io[3*block + r*SIMD_WIDTH]);
+  }
+}
+#endif
+
+/* physics_block for rows only known at run time, 2 and 4 rows are
+   blocked as such and any other number a block at a time. without
+   the diagnostics the generated kernels are used when there are
+   any. */
+static inline void physics_rows (size_t i, unsigned int rows,
+				 size_t j0, size_t j1,
+				 const value * px, const value * py,
+				 const value * m, int mode,
+				 simd * axo, simd * ayo,
+				 simd * po, simd * wo) {
+  unsigned int r;
+
+#ifdef PHYSICS_JIT
+  if (po == NULL && jit_kernels[rows] != NULL) {
+    physics_jit(i, rows, j0, j1, px, py, m, axo, ayo);
+    return;
+  }
+#endif
+
+  switch (rows) {
+  case 4:
+    physics_block(i, 4, j0, j1, px, py, m, mode, axo, ayo, po, wo);
+    break;
+
+  case 2:
+    physics_block(i, 2, j0, j1, px, py, m, mode, axo, ayo, po, wo);
+    break;
+
+  default:
+    for (r = 0; r < rows; r++)
+      physics_block(i + r*SIMD_WIDTH, 1, j0, j1, px, py, m, mode,
+		    &axo[r], &ayo[r],
+		    po != NULL ? &po[r] : NULL, po != NULL ? &wo[r] : NULL);
+  }
+}
+
+/* the diagnostics of the pulls on the block starting at i */
+static inline void physics_block_diagnose (double * d, size_t i,
+					   const value * m,
+					   simd po, simd wo) {
+  value p[SIMD_WIDTH], w[SIMD_WIDTH];
+  size_t l;
+
+  simd_storeu(p, po);
+  simd_storeu(w, wo);
+
+  for (l = 0; l < SIMD_WIDTH; l++)
+    physics_diagnose_pull(d, m[i + l], p[l], w[l]);
+}
+
+/* a single step, reads the accelerations a0 and writes a1, and
+   the diagnostics of this thread when diag is set */
+static void physics_step (value dt, size_t n,
+			  value * px, value * py,
+			  value * vx, value * vy,
+			  value * m,
+			  value * a0x, value * a0y,
+			  value * a1x, value * a1y,
+			  int diag) {
+  double sums[PHYSICS_DIAGNOSTICS] = {0.0};
+  int mode = rsqrt_mode;
+  unsigned int rows = tuned.block;
+  size_t i, i0, i1, slices, massive, tile;
+  size_t group = rows*SIMD_WIDTH;
+
+  simd d = simd_set1(dt);
+  simd h = simd_set1(value_literal(0.5)*dt);
+
+  /* every loop over the particles i gives a thread the same groups,
+     in the shares elastic.h keeps */
+  elastic_range((n + group-1)/group, &i0, &i1);
+
+  i0 *= group;
+  i1 = i1*group < n ? i1*group : n;
+
+  elastic_begin();
+
+  for (i = i0; i < i1; i += SIMD_WIDTH) {
+    simd dx;
+    simd dy;
+
+    /* px[i] += */
+    /*   (vx[i] + value_literal(0.5)*a0x[i]*dt)*dt; */
+    /* py[i] += */
+    /*   (vy[i] + value_literal(0.5)*a0y[i]*dt)*dt; */
+    dx = simd_mul(h, simd_load(&a0x[i]));
+    dy = simd_mul(h, simd_load(&a0y[i]));
+
+    dx = simd_add(dx, simd_load(&vx[i]));
+    dy = simd_add(dy, simd_load(&vy[i]));
+
+    dx = simd_mul(dx, d);
+    dy = simd_mul(dy, d);
+
+    simd_store(&px[i], simd_add(dx, simd_load(&px[i])));
+    simd_store(&py[i], simd_add(dy, simd_load(&py[i])));
+  }
+
+  elastic_end();
+
+  /* forces need every position */
+  NBODY_OMP_BARRIER
+
+  elastic_begin();
+
+  /* only the massive particles pull, see reorder.h */
+  massive = physics_massive(n, m);
+  slices = physics_slices(n, SIMD_WIDTH);
+
+  /* the diagnostics are summed over all j at once */
+  tile = tuned.tile > 0 && !diag ? tuned.tile : massive;
+
+  if (slices == 1) {
+    size_t j0 = 0, j1;
+
+    /* every thread gets the same groups of every tile, their sums
+       stay in a1 in between */
+    do {
+      j1 = j0 + tile < massive ? j0 + tile : massive;
+
+      for (i = i0; i < i1; i += group) {
+	simd axi[PHYSICS_ROWS], ayi[PHYSICS_ROWS];
+	simd po[PHYSICS_ROWS], wo[PHYSICS_ROWS];
+	unsigned int r, here = (n - i + SIMD_WIDTH-1)/SIMD_WIDTH;
+
+	if (here > rows)
+	  here = rows;
+
+	for (r = 0; r < here; r++) {
+	  axi[r] = j0 > 0 ? simd_load(&a1x[i + r*SIMD_WIDTH]) : simd_zero();
+	  ayi[r] = j0 > 0 ? simd_load(&a1y[i + r*SIMD_WIDTH]) : simd_zero();
+
+	  po[r] = simd_zero();
+	  wo[r] = simd_zero();
+	}
+
+	if (diag)
+	  physics_rows(i, here, j0, j1, px, py, m, mode, axi, ayi, po, wo);
+	else
+	  physics_rows(i, here, j0, j1, px, py, m, mode, axi, ayi, NULL, NULL);
+
+	for (r = 0; r < here; r++) {
+	  if (diag)
+	    physics_block_diagnose(sums, i + r*SIMD_WIDTH, m, po[r], wo[r]);
+
+	  simd_store(&a1x[i + r*SIMD_WIDTH], axi[r]);
+	  simd_store(&a1y[i + r*SIMD_WIDTH], ayi[r]);
+	}
+      }
+
+      j0 = j1;
+    } while (j0 < massive);
+  } else {
+    size_t blocks = (n + SIMD_WIDTH-1)/SIMD_WIDTH;
+    size_t stride = PHYSICS_SPLIT_STRIDE(n);
+    size_t w, w0, w1;
+
+    /* slice major, so consecutive items share their particles j */
+    elastic_range(slices*blocks, &w0, &w1);
+
+    for (w = w0; w < w1; w++) {
+      size_t s = w/blocks;
+      size_t k = (w%blocks)*SIMD_WIDTH;
+      simd axi = simd_zero(), ayi = simd_zero();
+      simd po = simd_zero(), wo = simd_zero();
+
+      if (diag) {
+	physics_block(k, 1, massive*s/slices, massive*(s+1)/slices,
+		      px, py, m, mode, &axi, &ayi, &po, &wo);
+	physics_block_diagnose(sums, k, m, po, wo);
+      } else {
+	physics_rows(k, 1, massive*s/slices, massive*(s+1)/slices,
+		     px, py, m, mode, &axi, &ayi, NULL, NULL);
+      }
+
+      simd_store(&apx[s*stride + k], axi);
+      simd_store(&apy[s*stride + k], ayi);
+    }
+
+    elastic_end();
+
+    NBODY_OMP_BARRIER
+
+    elastic_begin();
+
+    /* always in slice order, in the groups of the kick below */
+    for (i = i0; i < i1; i += group) {
+      size_t l;
+
+      for (l = i; l < i + group && l < n; l += SIMD_WIDTH) {
+	simd axi = simd_load(&apx[l]);
+	simd ayi = simd_load(&apy[l]);
+	size_t s;
+
+	for (s = 1; s < slices; s++) {
+	  axi = simd_add(axi, simd_load(&apx[s*stride + l]));
+	  ayi = simd_add(ayi, simd_load(&apy[s*stride + l]));
+	}
+
+	simd_store(&a1x[l], axi);
+	simd_store(&a1y[l], ayi);
+      }
+    }
+  }
+
+  /* scheduled like the forces, so every thread only reads the
+     accelerations it wrote itself */
+  for (i = i0; i < i1; i += group) {
+    size_t b;
+
+    for (b = i; b < i + group && b < n; b += SIMD_WIDTH) {
+      simd axi = simd_load(&a0x[b]);
+      simd ayi = simd_load(&a0y[b]);
+
+      simd dvx, dvy;
+      /* vx[i] += value_literal(0.5)*(a0x[i]+a1x[i])*dt; */
+      /* vy[i] += value_literal(0.5)*(a0y[i]+a1y[i])*dt; */
+      dvx = simd_mul(h, simd_add(axi, simd_load(&a1x[b])));
+      dvy = simd_mul(h, simd_add(ayi, simd_load(&a1y[b])));
+
+      simd_store(&vx[b], simd_add(dvx, simd_load(&vx[b])));
+      simd_store(&vy[b], simd_add(dvy, simd_load(&vy[b])));
+
+      if (diag) {
+	size_t l;
+
+	for (l = b; l < b + SIMD_WIDTH; l++) {
+	  physics_diagnose_motion(sums, px[l], py[l], vx[l], vy[l], m[l]);
+	  physics_diagnose_self(sums, m[l]);
+	}
+      }
+    }
+  }
+
+  if (diag)
+    for (i = 0; i < PHYSICS_DIAGNOSTICS; i++)
+      diagnosis[nbody_omp_thread()][i] = sums[i];
+
+  elastic_end();
+
+  /* the next step moves particles the forces may still be reading */
+  NBODY_OMP_BARRIER
+}
+
+/* k steps of n particles, no more than PHYSICS_FEW of them. n is a
+   constant wherever this is inlined, so every loop is unrolled and
+   the particles stay in registers from one step to the next, only
+   the positions the particles j are broadcast from go through
+   memory. the tracers among them pull with no mass, which adds
+   nothing, and the arithmetic is otherwise that of physics_step, so
+   are the results. the accelerations end up in a0. */
+static inline void physics_few (unsigned int k, value dt, size_t n,
+				value * px, value * py,
+				value * vx, value * vy,
+				const value * m) {
+  value qx[PHYSICS_FEW_BLOCKS*SIMD_WIDTH]
+    __attribute__((aligned(ALIGN_BOUNDARY)));
+  value qy[PHYSICS_FEW_BLOCKS*SIMD_WIDTH]
+    __attribute__((aligned(ALIGN_BOUNDARY)));
+
+  simd x[PHYSICS_FEW_BLOCKS], y[PHYSICS_FEW_BLOCKS];
+  simd u[PHYSICS_FEW_BLOCKS], v[PHYSICS_FEW_BLOCKS];
+  simd ax[PHYSICS_FEW_BLOCKS], ay[PHYSICS_FEW_BLOCKS];
+
+  simd d = simd_set1(dt);
+  simd h = simd_set1(value_literal(0.5)*dt);
+
+  size_t blocks = (n + SIMD_WIDTH-1)/SIMD_WIDTH, b;
+  int mode = rsqrt_mode;
+  unsigned int step;
+
+  for (b = 0; b < blocks; b++) {
+    x[b] = simd_load(&px[b*SIMD_WIDTH]);
+    y[b] = simd_load(&py[b*SIMD_WIDTH]);
+    u[b] = simd_load(&vx[b*SIMD_WIDTH]);
+    v[b] = simd_load(&vy[b*SIMD_WIDTH]);
+    ax[b] = simd_load(&a0x[b*SIMD_WIDTH]);
+    ay[b] = simd_load(&a0y[b*SIMD_WIDTH]);
+  }
+
+  for (step = 0; step < k; step++) {
+    simd a1x[PHYSICS_FEW_BLOCKS], a1y[PHYSICS_FEW_BLOCKS];
+
+    for (b = 0; b < blocks; b++) {
+      simd dx = simd_mul(h, ax[b]);
+      simd dy = simd_mul(h, ay[b]);
+
+      dx = simd_add(dx, u[b]);
+      dy = simd_add(dy, v[b]);
+
+      dx = simd_mul(dx, d);
+      dy = simd_mul(dy, d);
+
+      x[b] = simd_add(dx, x[b]);
+      y[b] = simd_add(dy, y[b]);
+
+      simd_store(&qx[b*SIMD_WIDTH], x[b]);
+      simd_store(&qy[b*SIMD_WIDTH], y[b]);
+    }
+
+    for (b = 0; b < blocks; b++) {
+      a1x[b] = simd_zero();
+      a1y[b] = simd_zero();
+
+      physics_block(b*SIMD_WIDTH, 1, 0, n, qx, qy, m, mode,
+		    &a1x[b], &a1y[b], NULL, NULL);
+    }
+
+    for (b = 0; b < blocks; b++) {
+      simd dvx = simd_mul(h, simd_add(ax[b], a1x[b]));
+      simd dvy = simd_mul(h, simd_add(ay[b], a1y[b]));
+
+      u[b] = simd_add(dvx, u[b]);
+      v[b] = simd_add(dvy, v[b]);
+
+      ax[b] = a1x[b];
+      ay[b] = a1y[b];
+    }
+  }
+
+  for (b = 0; b < blocks; b++) {
+    simd_store(&px[b*SIMD_WIDTH], x[b]);
+    simd_store(&py[b*SIMD_WIDTH], y[b]);
+    simd_store(&vx[b*SIMD_WIDTH], u[b]);
+    simd_store(&vy[b*SIMD_WIDTH], v[b]);
+    simd_store(&a0x[b*SIMD_WIDTH], ax[b]);
+    simd_store(&a0y[b*SIMD_WIDTH], ay[b]);
+  }
+}
+
+/* physics_few for n known at compile time, one case for every n up
+   to PHYSICS_FEW */
+#define PHYSICS_FEW_CASE(c)						\
+  case c:								\
+    physics_few(k, dt, c, px, py, vx, vy, m);				\
+    break;
+
+#define PHYSICS_FEW_CASES(c)						\
+  PHYSICS_FEW_CASE(c) PHYSICS_FEW_CASE(c+1)				\
+  PHYSICS_FEW_CASE(c+2) PHYSICS_FEW_CASE(c+3)
+
+static void physics_few_n (unsigned int k, value dt, size_t n,
+			   value * px, value * py,
+			   value * vx, value * vy,
+			   const value * m) {
+  switch (n) {
+  PHYSICS_FEW_CASES(1)
+  PHYSICS_FEW_CASES(5)
+  PHYSICS_FEW_CASES(9)
+  PHYSICS_FEW_CASES(13)
+  PHYSICS_FEW_CASES(17)
+  PHYSICS_FEW_CASES(21)
+  PHYSICS_FEW_CASES(25)
+  PHYSICS_FEW_CASES(29)
+  }
+}
+
+void physics_advance (value dt, size_t n,
+		      value * px, value * py,
+		      value * vx, value * vy,
+		      value * m) {
+  physics_advance_n(1, dt, n, px, py, vx, vy, m);
+}
+
+void physics_advance_n (unsigned int k, value dt, size_t n,
+			value * px, value * py,
+			value * vx, value * vy,
+			value * m) {
+  /* every thread swaps its own copy of the accelerations between
+     steps, the shared ones are only swapped once at the end */
+  value * b0x = a0x;
+  value * b0y = a0y;
+  value * b1x = a1x;
+  value * b1y = a1y;
+  unsigned int step, few = 0;
+
+  /* a few particles are stepped by the master alone, all but a last
+     step that diagnoses */
+  if (n <= PHYSICS_FEW) {
+    few = diagnose ? k-1 : k;
+
+    NBODY_OMP_MASTER
+    physics_few_n(few, dt, n, px, py, vx, vy, m);
+
+    NBODY_OMP_BARRIER
+  }
+
+  for (step = few; step < k; step++) {
+    value * tx;
+    value * ty;
+
+    physics_step(dt, n, px, py, vx, vy, m, b0x, b0y, b1x, b1y,
+		 diagnose && step == k-1);
+
+    tx = b0x;
+    b0x = b1x;
+    b1x = tx;
+
+    ty = b0y;
+    b0y = b1y;
+    b1y = ty;
+  }
+
+  NBODY_OMP_MASTER
+  {
+    if ((k - few) & 1)
+      physics_swap();
+
+    diagnose = 0;
+  }
+}
+
+int physics_diagnose (void) {
+  diagnose = 1;
+
+  return 1;
+}
+
+/* the fastest of PHYSICS_TUNE_STEPS steps of s particles with the
+   kernel configured as c, the first one is not timed */
+static double physics_tune_time (const struct tune * c, size_t s,
+				 value ** a) {
+  double fastest = HUGE_VAL, t0 = 0.0;
+
+  tuned = *c;
+  nbody_omp_set_threads(c->threads);
+
+  NBODY_OMP_PARALLEL
+  {
+    unsigned int step;
+
+    for (step = 0; step <= PHYSICS_TUNE_STEPS; step++) {
+      NBODY_OMP_MASTER
+      {
+	double t1 = tune_timer();
+
+	if (step > 1 && t1 - t0 < fastest)
+	  fastest = t1 - t0;
+
+	t0 = t1;
+      }
+
+      /* which ends in a barrier, so the master times all threads */
+      physics_step(value_literal(1e-6), s, a[0], a[1], a[2], a[3], a[4],
+		   a[5], a[6], a[7], a[8], 0);
+    }
+
+    NBODY_OMP_MASTER
+    {
+      double t1 = tune_timer();
+
+      if (t1 - t0 < fastest)
+	fastest = t1 - t0;
+    }
+  }
+
+  return fastest;
+}
+
+/* the thread count to try after t, powers of two up to all of them
+   and then all of them, 0 when done */
+static int physics_tune_threads (int t, int threads) {
+  if (t >= threads)
+    return 0;
+
+  return 2*t < threads ? 2*t : threads;
+}
+
+/* times every candidate on a sample of particles laid out on a
+   spiral and returns the fastest */
+static struct tune physics_tune_measure (size_t n, int threads,
+					 int fixed) {
+  static const size_t tiles[] = {0, 256, 1024};
+  static const unsigned int blocks[] = {1, 2, 4};
+
+  size_t s = n < PHYSICS_TUNE_SAMPLE ? n : PHYSICS_TUNE_SAMPLE;
+  struct tune best = {0, 1, threads}, c;
+  double fastest = HUGE_VAL;
+  value * a[9];
+  size_t i, k, l;
+
+  for (k = 0; k < 9; k++) {
+    a[k] =
+      align_padded_malloc(ALIGN_BOUNDARY, s*sizeof(value), ALLOC_PADDING);
+
+    if (a[k] == NULL) {
+      perror(__func__);
+      exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < s; i++)
+      a[k][i] = value_literal(0.0);
+  }
+
+  for (i = 0; i < s; i++) {
+    double r = sqrt((i + 0.5)/s), phi = 2.39996323*i;
+
+    a[0][i] = r*cos(phi);
+    a[1][i] = r*sin(phi);
+    a[4][i] = value_literal(1.0)/s;
+  }
+
+  for (c.threads = fixed ? threads : 1; c.threads > 0;
+       c.threads = physics_tune_threads(c.threads, threads))
+    for (k = 0; k < sizeof(tiles)/sizeof(tiles[0]); k++)
+      for (l = 0; l < sizeof(blocks)/sizeof(blocks[0]); l++) {
+	double t;
+
+	if (tiles[k] >= s)
+	  continue;
+
+	c.tile = tiles[k];
+	c.block = blocks[l];
+
+	t = physics_tune_time(&c, s, a);
+
+	if (t < fastest) {
+	  fastest = t;
+	  best = c;
+	}
+      }
+
+  for (k = 0; k < 9; k++)
+    align_free(a[k]);
+
+  return best;
+}
+
+void physics_tune (size_t n) {
+  char kernel[64];
+  int threads = nbody_omp_max_threads();
+  /* the thread count is left alone when it was asked for */
+  int fixed = getenv("OMP_NUM_THREADS") != NULL;
+  int mode = tune_mode();
+  const char * how = "measured";
+  struct tune c = {0, 1, threads};
+
+#ifdef _OPENMP
+  snprintf(kernel, sizeof(kernel), "simd%d-openmp", SIMD_WIDTH);
+#else
+  snprintf(kernel, sizeof(kernel), "simd%d", SIMD_WIDTH);
+#endif
+
+#ifdef PHYSICS_JIT
+  /* the generated kernels are fastest in a configuration of their
+     own */
+  if (jit_kernels[1] != NULL)
+    strcat(kernel, "-jit");
+#endif
+
+  if (n <= PHYSICS_FEW) {
+    /* which the master steps alone, see physics_advance_n */
+    how = "few";
+    c.threads = 1;
+  } else if (mode == TUNE_OFF) {
+    how = "off";
+  } else if (mode == TUNE_CACHED && tune_load(kernel, n, &c)) {
+    how = "cached";
+  } else {
+    c = physics_tune_measure(n, threads, fixed);
+
+    /* the thread count of a fixed run was not measured, so it is not
+       what other runs should start with */
+    if (!fixed)
+      tune_save(kernel, n, &c);
+  }
+
+  if (fixed || c.threads > threads)
+    c.threads = threads;
+
+  /* physics_rows has no loop for any other block */
+  if (c.block == 0 || c.block > PHYSICS_ROWS ||
+      (c.block & (c.block - 1)) != 0)
+    c.block = 1;
+
+  tuned = c;
+  nbody_omp_set_threads(c.threads);
+
+  printf("tuned %s, tile %zu, block %u, threads %d, %s\n",
+	 kernel, c.tile, c.block, c.threads, how);
+}
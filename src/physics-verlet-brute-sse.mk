@@ -1,5 +1,6 @@
 CPPFLAGS += -DVECTOR_SIZE=2 -DALIGN_BOUNDARY=16 -DALLOC_PADDING=16
-CFLAGS += -msse
+CPPFLAGS += -DPHYSICS_RSQRT=RSQRT_ESTIMATE -DSIMD_WIDTH=4 -DPHYSICS_TUNE
+CFLAGS += -msse -Wno-unknown-pragmas
 
-OBJS += physics-util.o
-DEPS += physics-util.d
+OBJS += physics-util.o rsqrt.o tune.o
+DEPS += physics-util.d rsqrt.d tune.d
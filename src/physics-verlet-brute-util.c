@@ -1,8 +1,14 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
 
 #include "align_malloc.h"
+#ifdef PHYSICS_JIT
+#include "jit.h"
+#endif
+#include "nbody-openmp.h"
+#ifdef PHYSICS_JIT
+#include "rsqrt.h"
+#endif
 
 #include "physics-verlet-brute-util.h"
 
@@ -12,6 +18,38 @@ value * a0y = NULL;
 value * a1x = NULL;
 value * a1y = NULL;
 
+value * apx = NULL;
+value * apy = NULL;
+
+int diagnose = 0;
+double (* diagnosis)[PHYSICS_DIAGNOSTICS] = NULL;
+
+/* most slices physics_slices can ask for */
+static size_t physics_slices_max (size_t n) {
+  size_t slices = n/PHYSICS_SPLIT_J;
+
+  if (n > PHYSICS_SPLIT_N || slices < 1)
+    return 1;
+
+  return slices < PHYSICS_SPLIT_SLICES ? slices : PHYSICS_SPLIT_SLICES;
+}
+
+size_t physics_slices (size_t n, size_t width) {
+  size_t blocks = (n + width-1)/width;
+
+  if (blocks >= PHYSICS_SPLIT_ITEMS*(size_t) nbody_omp_threads())
+    return 1;
+
+  return physics_slices_max(n);
+}
+
+size_t physics_massive (size_t n, const value * m) {
+  while (n > 0 && m[n-1] == value_literal(0.0))
+    n -= 1;
+
+  return n;
+}
+
 void physics_swap (void) {
   value * tx;
   value * ty;
@@ -25,7 +63,27 @@ void physics_swap (void) {
   a1y = ty;
 }
 
+void physics_diagnostics (double * d) {
+  int t, threads = nbody_omp_max_threads();
+  int i;
+
+  for (i = 0; i < PHYSICS_DIAGNOSTICS; i++)
+    d[i] = 0.0;
+
+  for (t = 0; t < threads; t++)
+    for (i = 0; i < PHYSICS_DIAGNOSTICS; i++)
+      d[i] += diagnosis[t][i];
+}
+
 void physics_free (void) {
+#ifdef PHYSICS_JIT
+  jit_free();
+#endif
+
+  free(diagnosis);
+
+  align_free(apy);
+  align_free(apx);
   align_free(a1y);
   align_free(a1x);
   align_free(a0y);
@@ -35,9 +93,16 @@ void physics_free (void) {
   a0y = NULL;
   a1x = NULL;
   a1y = NULL;
+
+  apx = NULL;
+  apy = NULL;
+
+  diagnosis = NULL;
 }
 
 void physics_init (size_t n) {
+  size_t split_n;
+
   a0x =
     align_padded_malloc(ALIGN_BOUNDARY, n*sizeof(value), ALLOC_PADDING);
   a0y =
@@ -47,17 +112,89 @@ void physics_init (size_t n) {
   a1y =
     align_padded_malloc(ALIGN_BOUNDARY, n*sizeof(value), ALLOC_PADDING);
 
-  if (a0x == NULL || a0y == NULL || a1x == NULL || a1y == NULL) {
+  diagnosis =
+    calloc(nbody_omp_max_threads(), sizeof(*diagnosis));
+
+  if (a0x == NULL || a0y == NULL || a1x == NULL || a1y == NULL ||
+      diagnosis == NULL) {
     perror(__func__);
     exit(EXIT_FAILURE);
   }
 
+  /* collisions can bring n down to where it is split */
+  split_n = n < PHYSICS_SPLIT_N ? n : PHYSICS_SPLIT_N;
+
+  if (physics_slices_max(split_n) > 1) {
+    size_t size = physics_slices_max(split_n)*PHYSICS_SPLIT_STRIDE(split_n);
+
+    apx = align_malloc(ALIGN_BOUNDARY, size*sizeof(value));
+    apy = align_malloc(ALIGN_BOUNDARY, size*sizeof(value));
+
+    if (apx == NULL || apy == NULL) {
+      perror(__func__);
+      exit(EXIT_FAILURE);
+    }
+  }
+
   physics_reset(n);
+
+#ifdef PHYSICS_JIT
+  jit_init(SIMD_WIDTH, rsqrt_mode);
+#endif
+
+#ifdef PHYSICS_TUNE
+  physics_tune(n);
+#endif
+}
+
+void physics_merge (size_t n, const size_t * into, const value * m) {
+  size_t i;
+
+  /* the mass weighted acceleration keeps the next kick from
+     changing the total momentum */
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++) {
+    size_t j = into[i];
+    value M;
+
+    if (j == n)
+      continue;
+
+    M = m[i] + m[j];
+
+    if (M > value_literal(0.0)) {
+      a0x[i] = (m[i]*a0x[i] + m[j]*a0x[j])/M;
+      a0y[i] = (m[i]*a0y[i] + m[j]*a0y[j])/M;
+    }
+  }
+}
+
+void physics_reorder (size_t n, const size_t * order) {
+  size_t i;
+
+  /* a1 is scratch between steps */
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++) {
+    a1x[i] = a0x[order[i]];
+    a1y[i] = a0y[order[i]];
+  }
+
+  NBODY_OMP_MASTER
+  physics_swap();
+
+  NBODY_OMP_BARRIER
+    ;
 }
 
 void physics_reset (size_t n) {
-  memset(a0x, 0, n*sizeof(value));
-  memset(a0y, 0, n*sizeof(value));
-  memset(a1x, 0, n*sizeof(value));
-  memset(a1y, 0, n*sizeof(value));
+  size_t i;
+
+  /* same schedule as the kernels so no page changes hands */
+  NBODY_OMP_PARALLEL_FOR
+  for (i = 0; i < n; i++) {
+    a0x[i] = 0;
+    a0y[i] = 0;
+    a1x[i] = 0;
+    a1y[i] = 0;
+  }
 }
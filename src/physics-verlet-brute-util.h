@@ -1,6 +1,8 @@
 #ifndef PHYSICS_VERLET_BRUTE_UTIL_H
 #define PHYSICS_VERLET_BRUTE_UTIL_H 1
 
+#include "nbody-openmp.h"
+#include "physics-diagnose.h"
 #include "physics.h"
 
 extern value * a0x;
@@ -9,6 +11,43 @@ extern value * a0y;
 extern value * a1x;
 extern value * a1y;
 
+/*
+ * With few particles per thread the force loop is split over j as
+ * well as i. Every slice of j accumulates into its own row of the
+ * partial accelerations, which are then summed in slice order, so
+ * the result does not depend on which thread did what.
+ *
+ * The split happens when there are fewer than PHYSICS_SPLIT_ITEMS
+ * blocks of i per thread and never above PHYSICS_SPLIT_N particles.
+ * Slices hold at least PHYSICS_SPLIT_J particles and there are at
+ * most PHYSICS_SPLIT_SLICES of them.
+ */
+#define PHYSICS_SPLIT_ITEMS  4
+#define PHYSICS_SPLIT_N      4096
+#define PHYSICS_SPLIT_J      32
+#define PHYSICS_SPLIT_SLICES 64
+
+/* distance between the rows of the partial accelerations, rows
+   start on separate cache lines */
+#define PHYSICS_SPLIT_STRIDE(n) (((n) + 15) & ~(size_t) 15)
+
+extern value * apx;
+extern value * apy;
+
+/* number of j slices for the force loop over blocks of width
+   particles, 1 when it is not split */
+extern size_t physics_slices (size_t n, size_t width);
+
+/* number of particles up to and including the last one with mass,
+   only those exert any force. reordering sorts the massless tracers
+   last, so this is the number of massive particles. */
+extern size_t physics_massive (size_t n, const value * m);
+
 extern void physics_swap (void);
 
+/* picks the tiles, blocks and threads the kernel runs n particles
+   with, see tune.h. called by physics_init in kernels built with
+   PHYSICS_TUNE. */
+extern void physics_tune (size_t n);
+
 #endif /* PHYSICS_VERLET_BRUTE_UTIL_H */
@@ -4,11 +4,13 @@
 
 static const value G = GRAVITATIONAL_CONSTANT;
 
-void physics_advance (value dt, size_t n,
-		      value * px, value * py,
-		      value * vx, value * vy,
-		      value * m) {
-  size_t i, j;
+/* a single step, and the diagnostics when diag is set */
+static void physics_step (value dt, size_t n,
+			  value * px, value * py,
+			  value * vx, value * vy,
+			  value * m, int diag) {
+  double sums[PHYSICS_DIAGNOSTICS] = {0.0};
+  size_t i, j, massive = physics_massive(n, m);
 
   for (i = 0; i < n; i++) {
     px[i] +=
@@ -20,16 +22,17 @@ void physics_advance (value dt, size_t n,
     a1y[i] = value_literal(0.0);
   }
 
-  for (i = 0; i < n; i++) {
+  /* pairs of massless particles are left out */
+  for (i = 0; i < massive; i++) {
     for (j = i+1; j < n; j++) {
       value a[VECTOR_SIZE], r[VECTOR_SIZE];
-      value s;
+      value s, s0;
 
       r[0] = px[j] - px[i];
       r[1] = py[j] - py[i];
 
-      s = (r[0]*r[0] + r[1]*r[1]) + SOFTENING*SOFTENING;
-      s = s*s*s;
+      s0 = (r[0]*r[0] + r[1]*r[1]) + SOFTENING*SOFTENING;
+      s = s0*s0*s0;
       s = value_literal(1.0)/sqrtv(s);
 
       a[0] = G*r[0]*s;
@@ -40,13 +43,50 @@ void physics_advance (value dt, size_t n,
 
       a1x[j] -= a[0] * m[i];
       a1y[j] -= a[1] * m[i];
+
+      /* every pair is only seen from i */
+      if (diag)
+	physics_diagnose_pull(sums, m[i], 2.0*m[j]*s0*s,
+			      2.0*m[j]*(s0 - SOFTENING*SOFTENING)*s);
     }
   }
 
   for (i = 0; i < n; i++) {
     vx[i] += value_literal(0.5)*(a0x[i]+a1x[i])*dt;
     vy[i] += value_literal(0.5)*(a0y[i]+a1y[i])*dt;
+
+    if (diag)
+      physics_diagnose_motion(sums, px[i], py[i], vx[i], vy[i], m[i]);
   }
 
+  if (diag)
+    for (i = 0; i < PHYSICS_DIAGNOSTICS; i++)
+      diagnosis[0][i] = sums[i];
+
   physics_swap();
 }
+
+void physics_advance (value dt, size_t n,
+		      value * px, value * py,
+		      value * vx, value * vy,
+		      value * m) {
+  physics_step(dt, n, px, py, vx, vy, m, 0);
+}
+
+void physics_advance_n (unsigned int k, value dt, size_t n,
+			value * px, value * py,
+			value * vx, value * vy,
+			value * m) {
+  unsigned int step;
+
+  for (step = 0; step < k; step++)
+    physics_step(dt, n, px, py, vx, vy, m, diagnose && step == k-1);
+
+  diagnose = 0;
+}
+
+int physics_diagnose (void) {
+  diagnose = 1;
+
+  return 1;
+}
@@ -0,0 +1,461 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "align_malloc.h"
+#include "nbody-openmp.h"
+
+#include "physics-verlet-encounter.h"
+
+static const value G = GRAVITATIONAL_CONSTANT;
+
+/* accelerations without the partner's pull, a0 of the last step and
+   a1 of this one */
+static value * a0x = NULL;
+static value * a0y = NULL;
+
+static value * a1x = NULL;
+static value * a1y = NULL;
+
+/* partner of every particle, n when it has none, p0 of this step and
+   p1 of the next */
+static size_t * p0 = NULL;
+static size_t * p1 = NULL;
+
+/* nearest neighbour within ENCOUNTER_RADIUS, n when there is none */
+static size_t * near = NULL;
+
+/* particles the arrays have room for */
+static size_t capacity;
+
+/* pull of j on i */
+static inline void physics_pull (size_t i, size_t j,
+				 const value * px, const value * py,
+				 const value * m,
+				 value * ax, value * ay) {
+  value r[VECTOR_SIZE];
+  value s;
+
+  r[0] = px[j] - px[i];
+  r[1] = py[j] - py[i];
+
+  s = (r[0]*r[0] + r[1]*r[1]) + SOFTENING*SOFTENING;
+  s = s*s*s;
+  s = value_literal(1.0)/sqrtv(s);
+
+  s = s*m[j];
+
+  *ax = G*r[0]*s;
+  *ay = G*r[1]*s;
+}
+
+/* one substep of the time-transformed leapfrog of the separation r
+   under the softened pull mu, with the time transformation
+   1/sqrt(r^2 + e^2) carried along in w. returns the time taken. */
+static double physics_ttl (double h, double mu, double e2,
+			   double r[2], double v[2], double * w) {
+  double d0, d1, s2, s, t, u[2];
+
+  d0 = 0.5*h / *w;
+  r[0] += d0*v[0];
+  r[1] += d0*v[1];
+
+  s2 = r[0]*r[0] + r[1]*r[1] + e2;
+  s = sqrt(s2);
+  t = h*s;
+
+  u[0] = v[0] - t*mu*r[0]/(s2*s);
+  u[1] = v[1] - t*mu*r[1]/(s2*s);
+
+  /* the gradient of the transformation along the mean velocity */
+  *w -= t*(r[0]*(v[0] + u[0]) + r[1]*(v[1] + u[1]))/(2.0*s2*s);
+
+  v[0] = u[0];
+  v[1] = u[1];
+
+  d1 = 0.5*h / *w;
+  r[0] += d1*v[0];
+  r[1] += d1*v[1];
+
+  return d0 + d1;
+}
+
+/* moves the separation r and relative velocity v for exactly dt */
+static void physics_regularised (double dt, double mu,
+				 double r[2], double v[2]) {
+  double e2 = SOFTENING*SOFTENING;
+  double s = sqrt(r[0]*r[0] + r[1]*r[1] + e2);
+  double w = 1.0/s;
+  double t = 0.0;
+  double h, d = 0.0;
+  double r0[2], v0[2], w0;
+  int i;
+
+  if (mu == 0.0 || dt == 0.0) {
+    r[0] += v[0]*dt;
+    r[1] += v[1]*dt;
+    return;
+  }
+
+  /* substeps of about ENCOUNTER_ETA dynamical times, in the
+     transformed time where a substep takes h*s */
+  h = ENCOUNTER_ETA*sqrt(s/mu);
+  h = dt < 0.0 ? -h : h;
+
+  for (i = 1; ; i++) {
+    r0[0] = r[0];
+    r0[1] = r[1];
+    v0[0] = v[0];
+    v0[1] = v[1];
+    w0 = w;
+
+    d = physics_ttl(h, mu, e2, r, v, &w);
+
+    if (fabs(t + d) >= fabs(dt) || i == ENCOUNTER_MAX_STEPS)
+      break;
+
+    t += d;
+  }
+
+  /* the last substep is redone, resized until it ends at dt */
+  for (i = 0; i < 4; i++) {
+    h *= (dt - t)/d;
+
+    r[0] = r0[0];
+    r[1] = r0[1];
+    v[0] = v0[0];
+    v[1] = v0[1];
+    w = w0;
+
+    d = physics_ttl(h, mu, e2, r, v, &w);
+  }
+}
+
+/* the drift of the pair i, j */
+static void physics_pair (value dt, size_t i, size_t j,
+			  value * px, value * py,
+			  value * vx, value * vy,
+			  const value * m) {
+  double M = (double) m[i] + m[j];
+  double cx, cy, ux, uy;
+  double r[2], v[2];
+
+  if (M == 0.0) {
+    px[i] += vx[i]*dt;
+    py[i] += vy[i]*dt;
+    px[j] += vx[j]*dt;
+    py[j] += vy[j]*dt;
+    return;
+  }
+
+  cx = (m[i]*(double) px[i] + m[j]*(double) px[j])/M;
+  cy = (m[i]*(double) py[i] + m[j]*(double) py[j])/M;
+  ux = (m[i]*(double) vx[i] + m[j]*(double) vx[j])/M;
+  uy = (m[i]*(double) vy[i] + m[j]*(double) vy[j])/M;
+
+  r[0] = (double) px[j] - px[i];
+  r[1] = (double) py[j] - py[i];
+  v[0] = (double) vx[j] - vx[i];
+  v[1] = (double) vy[j] - vy[i];
+
+  physics_regularised(dt, G*M, r, v);
+
+  cx += ux*dt;
+  cy += uy*dt;
+
+  px[i] = cx - m[j]/M*r[0];
+  py[i] = cy - m[j]/M*r[1];
+  px[j] = cx + m[i]/M*r[0];
+  py[j] = cy + m[i]/M*r[1];
+
+  vx[i] = ux - m[j]/M*v[0];
+  vy[i] = uy - m[j]/M*v[1];
+  vx[j] = ux + m[i]/M*v[0];
+  vy[j] = uy + m[i]/M*v[1];
+}
+
+/* a single step, reads the accelerations a0 and partners p0 and
+   writes a1 and p1 */
+static void physics_step (value dt, size_t n,
+			  value * px, value * py,
+			  value * vx, value * vy,
+			  value * m,
+			  value * a0x, value * a0y,
+			  value * a1x, value * a1y,
+			  size_t * p0, size_t * p1) {
+  value h = value_literal(0.5)*dt;
+  size_t i;
+
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < n; i++) {
+    vx[i] += h*a0x[i];
+    vy[i] += h*a0y[i];
+  }
+
+  /* pairs move both of their particles */
+  NBODY_OMP_BARRIER
+
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < n; i++) {
+    if (p0[i] == n) {
+      px[i] += vx[i]*dt;
+      py[i] += vy[i]*dt;
+    } else if (i < p0[i]) {
+      physics_pair(dt, i, p0[i], px, py, vx, vy, m);
+    }
+  }
+
+  /* forces need every position */
+  NBODY_OMP_BARRIER
+
+  /* every pull, with the nearest neighbour found along the way */
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < n; i++) {
+    value ax = value_literal(0.0);
+    value ay = value_literal(0.0);
+    value d = ENCOUNTER_RADIUS*ENCOUNTER_RADIUS;
+    size_t j, k = n;
+
+    for (j = 0; j < n; j++) {
+      value r[VECTOR_SIZE];
+      value s;
+
+      r[0] = px[j] - px[i];
+      r[1] = py[j] - py[i];
+
+      s = r[0]*r[0] + r[1]*r[1];
+
+      if (s < d && j != i) {
+	d = s;
+	k = j;
+      }
+
+      s = s + SOFTENING*SOFTENING;
+      s = s*s*s;
+      s = value_literal(1.0)/sqrtv(s);
+
+      s = s*m[j];
+
+      ax += G*r[0]*s;
+      ay += G*r[1]*s;
+    }
+
+    a1x[i] = ax;
+    a1y[i] = ay;
+
+    near[i] = k;
+  }
+
+  /* pairs need both nearest neighbours */
+  NBODY_OMP_BARRIER
+
+  /* the kick leaves out the partner the pair drifted with, the next
+     one the partner it will drift with */
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < n; i++) {
+    value ax = a1x[i];
+    value ay = a1y[i];
+    value bx, by;
+    size_t k = near[i];
+
+    if (p0[i] != n) {
+      physics_pull(i, p0[i], px, py, m, &bx, &by);
+
+      vx[i] += h*(ax - bx);
+      vy[i] += h*(ay - by);
+    } else {
+      vx[i] += h*ax;
+      vy[i] += h*ay;
+    }
+
+    p1[i] = k != n && near[k] == i ? k : n;
+
+    if (p1[i] != n) {
+      physics_pull(i, p1[i], px, py, m, &bx, &by);
+
+      ax -= bx;
+      ay -= by;
+    }
+
+    a1x[i] = ax;
+    a1y[i] = ay;
+  }
+}
+
+static void physics_swap (void) {
+  value * tx;
+  value * ty;
+  size_t * tp;
+
+  tx = a0x;
+  a0x = a1x;
+  a1x = tx;
+
+  ty = a0y;
+  a0y = a1y;
+  a1y = ty;
+
+  tp = p0;
+  p0 = p1;
+  p1 = tp;
+}
+
+void physics_advance (value dt, size_t n,
+		      value * px, value * py,
+		      value * vx, value * vy,
+		      value * m) {
+  physics_advance_n(1, dt, n, px, py, vx, vy, m);
+}
+
+void physics_advance_n (unsigned int k, value dt, size_t n,
+			value * px, value * py,
+			value * vx, value * vy,
+			value * m) {
+  /* every thread swaps its own copy of the accelerations and
+     partners between steps, the shared ones are only swapped once
+     at the end */
+  value * b0x = a0x;
+  value * b0y = a0y;
+  value * b1x = a1x;
+  value * b1y = a1y;
+  size_t * q0 = p0;
+  size_t * q1 = p1;
+  unsigned int step;
+
+  for (step = 0; step < k; step++) {
+    value * tx;
+    value * ty;
+    size_t * tq;
+
+    physics_step(dt, n, px, py, vx, vy, m, b0x, b0y, b1x, b1y, q0, q1);
+
+    tx = b0x;
+    b0x = b1x;
+    b1x = tx;
+
+    ty = b0y;
+    b0y = b1y;
+    b1y = ty;
+
+    tq = q0;
+    q0 = q1;
+    q1 = tq;
+  }
+
+  /* the last kicks are the only loop not followed by a barrier */
+  NBODY_OMP_BARRIER
+
+  NBODY_OMP_MASTER
+  if (k & 1)
+    physics_swap();
+}
+
+int physics_diagnose (void) {
+  /* close pairs move in substeps of their own outside the force
+     loop, whose sums would leave their energy out */
+  return 0;
+}
+
+void physics_diagnostics (double * d) {
+  (void) d;
+}
+
+void physics_free (void) {
+  align_free(near);
+  align_free(p1);
+  align_free(p0);
+  align_free(a1y);
+  align_free(a1x);
+  align_free(a0y);
+  align_free(a0x);
+}
+
+void physics_init (size_t n) {
+  capacity = n;
+
+  a0x = align_malloc(ALIGN_BOUNDARY, n*sizeof(value));
+  a0y = align_malloc(ALIGN_BOUNDARY, n*sizeof(value));
+  a1x = align_malloc(ALIGN_BOUNDARY, n*sizeof(value));
+  a1y = align_malloc(ALIGN_BOUNDARY, n*sizeof(value));
+
+  p0 = align_malloc(ALIGN_BOUNDARY, n*sizeof(size_t));
+  p1 = align_malloc(ALIGN_BOUNDARY, n*sizeof(size_t));
+  near = align_malloc(ALIGN_BOUNDARY, n*sizeof(size_t));
+
+  if (a0x == NULL || a0y == NULL || a1x == NULL || a1y == NULL ||
+      p0 == NULL || p1 == NULL || near == NULL) {
+    perror(__func__);
+    exit(EXIT_FAILURE);
+  }
+
+  physics_reset(n);
+}
+
+void physics_merge (size_t n, const size_t * into, const value * m) {
+  size_t i;
+
+  /* both leave out the pull of their partner, the partner goes away
+     with the merger */
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++) {
+    size_t j = into[i];
+    value M;
+
+    if (j == n)
+      continue;
+
+    M = m[i] + m[j];
+
+    if (M > value_literal(0.0)) {
+      a0x[i] = (m[i]*a0x[i] + m[j]*a0x[j])/M;
+      a0y[i] = (m[i]*a0y[i] + m[j]*a0y[j])/M;
+    }
+  }
+}
+
+void physics_reorder (size_t n, const size_t * order) {
+  size_t i;
+
+  /* near is scratch between steps, it holds the new slot of every
+     old one so the partners can follow their particles, or n for
+     the particles that were removed */
+  NBODY_OMP_FOR
+  for (i = 0; i < capacity; i++)
+    near[i] = n;
+
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++)
+    near[order[i]] = i;
+
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++) {
+    size_t p = p0[order[i]];
+
+    a1x[i] = a0x[order[i]];
+    a1y[i] = a0y[order[i]];
+
+    p1[i] = p >= capacity ? n : near[p];
+  }
+
+  NBODY_OMP_MASTER
+  physics_swap();
+
+  NBODY_OMP_BARRIER
+    ;
+}
+
+void physics_reset (size_t n) {
+  size_t i;
+
+  NBODY_OMP_PARALLEL_FOR
+  for (i = 0; i < n; i++) {
+    a0x[i] = 0;
+    a0y[i] = 0;
+    a1x[i] = 0;
+    a1y[i] = 0;
+
+    p0[i] = n;
+    p1[i] = n;
+    near[i] = n;
+  }
+}
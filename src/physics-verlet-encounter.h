@@ -0,0 +1,23 @@
+#ifndef PHYSICS_VERLET_ENCOUNTER_H
+#define PHYSICS_VERLET_ENCOUNTER_H 1
+
+#include "physics.h"
+
+/*
+ * Two particles that are each other's nearest neighbour and closer
+ * than ENCOUNTER_RADIUS form a pair. The kicks leave out the pull
+ * of a particle's partner, and instead of drifting in a straight
+ * line a pair moves its center of mass in a straight line and its
+ * separation by a time-transformed leapfrog, whose substeps shrink
+ * with the separation, so the rest of the system keeps its dt and
+ * SOFTENING can be made small.
+ *
+ * A substep is about ENCOUNTER_ETA of the pair's dynamical time at
+ * the start of the step, and a step takes at most
+ * ENCOUNTER_MAX_STEPS of them before the last one stretches to fit.
+ */
+#define ENCOUNTER_RADIUS    value_literal(5e-2)      /* m */
+#define ENCOUNTER_ETA       1e-2
+#define ENCOUNTER_MAX_STEPS 4096
+
+#endif /* PHYSICS_VERLET_ENCOUNTER_H */
@@ -0,0 +1,428 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <immintrin.h>
+
+#include "align_malloc.h"
+#include "ensemble.h"
+#include "nbody-openmp.h"
+#include "physics.h"
+#include "rsqrt.h"
+
+#define LANES 8
+#define BODIES ENSEMBLE_BODIES
+
+static const value G = GRAVITATIONAL_CONSTANT;
+
+/*
+ * The ensemble is kept array of structures of arrays. A block holds
+ * LANES systems side by side, lane l of every register belongs to
+ * system b*LANES+l of block b. Body j of the system in lane l is at
+ * [(b*BODIES + j)*LANES + l]. Lanes past the last system and bodies
+ * past n have no mass and feel no force.
+ *
+ * Systems are independent so a block is gathered from the particle
+ * arrays, stepped k times and scattered back by the one thread that
+ * owns it, without any synchronisation in between.
+ */
+static size_t blocks;
+
+static value * ex;
+static value * ey;
+
+static value * evx;
+static value * evy;
+
+static value * em;
+
+/* accelerations of the last step */
+static value * eax;
+static value * eay;
+
+/* scratch for physics_reorder */
+static value * tax;
+static value * tay;
+
+/* per system energy at the start of the run and the largest
+   relative deviation from it seen so far */
+static double * energy0;
+static double * energy_error;
+static size_t systems;
+static int measured;
+
+static inline size_t ensemble_index (size_t slot) {
+  size_t s = slot/BODIES;
+  size_t j = slot%BODIES;
+
+  return ((s/LANES)*BODIES + j)*LANES + s%LANES;
+}
+
+static void ensemble_gather (size_t b, size_t n,
+			     const value * px, const value * py,
+			     const value * vx, const value * vy,
+			     const value * m) {
+  size_t j, l;
+
+  for (j = 0; j < BODIES; j++) {
+    for (l = 0; l < LANES; l++) {
+      size_t slot = (b*LANES + l)*BODIES + j;
+      size_t k = (b*BODIES + j)*LANES + l;
+
+      if (slot < n) {
+	ex[k]  = px[slot];
+	ey[k]  = py[slot];
+	evx[k] = vx[slot];
+	evy[k] = vy[slot];
+	em[k]  = m[slot];
+      } else {
+	ex[k]  = value_literal(0.0);
+	ey[k]  = value_literal(0.0);
+	evx[k] = value_literal(0.0);
+	evy[k] = value_literal(0.0);
+	em[k]  = value_literal(0.0);
+      }
+    }
+  }
+}
+
+static void ensemble_scatter (size_t b, size_t n,
+			      value * px, value * py,
+			      value * vx, value * vy) {
+  size_t j, l;
+
+  for (j = 0; j < BODIES; j++) {
+    for (l = 0; l < LANES; l++) {
+      size_t slot = (b*LANES + l)*BODIES + j;
+      size_t k = (b*BODIES + j)*LANES + l;
+
+      if (slot < n) {
+	px[slot] = ex[k];
+	py[slot] = ey[k];
+	vx[slot] = evx[k];
+	vy[slot] = evy[k];
+      }
+    }
+  }
+}
+
+/* one step of the LANES systems of a block */
+static void ensemble_step (value dt, value * x, value * y,
+			   value * vx, value * vy, const value * m,
+			   value * ax, value * ay) {
+  __m256 g = _mm256_set1_ps(G);
+  __m256 e = _mm256_set1_ps(SOFTENING*SOFTENING);
+  __m256 d = _mm256_set1_ps(dt);
+  __m256 h = _mm256_set1_ps(value_literal(0.5)*dt);
+
+  __m256 a1x[BODIES];
+  __m256 a1y[BODIES];
+
+  int mode = rsqrt_mode;
+  size_t i, j;
+
+  for (i = 0; i < BODIES; i++) {
+    __m256 dx, dy;
+
+    /* px[i] += (vx[i] + value_literal(0.5)*a0x[i]*dt)*dt; */
+    dx = _mm256_mul_ps(h, _mm256_load_ps(&ax[i*LANES]));
+    dy = _mm256_mul_ps(h, _mm256_load_ps(&ay[i*LANES]));
+
+    dx = _mm256_mul_ps(_mm256_add_ps(dx, _mm256_load_ps(&vx[i*LANES])), d);
+    dy = _mm256_mul_ps(_mm256_add_ps(dy, _mm256_load_ps(&vy[i*LANES])), d);
+
+    _mm256_store_ps(&x[i*LANES], _mm256_add_ps(dx, _mm256_load_ps(&x[i*LANES])));
+    _mm256_store_ps(&y[i*LANES], _mm256_add_ps(dy, _mm256_load_ps(&y[i*LANES])));
+  }
+
+  for (i = 0; i < BODIES; i++) {
+    __m256 xi = _mm256_load_ps(&x[i*LANES]);
+    __m256 yi = _mm256_load_ps(&y[i*LANES]);
+
+    __m256 axi = _mm256_setzero_ps();
+    __m256 ayi = _mm256_setzero_ps();
+
+    /* the body itself is at distance 0 and adds nothing */
+    for (j = 0; j < BODIES; j++) {
+      __m256 rx = _mm256_sub_ps(_mm256_load_ps(&x[j*LANES]), xi);
+      __m256 ry = _mm256_sub_ps(_mm256_load_ps(&y[j*LANES]), yi);
+      __m256 s;
+
+      /* s = (r[0]*r[0] + r[1]*r[1]) + SOFTENING*SOFTENING; */
+      s = _mm256_add_ps(_mm256_mul_ps(rx, rx),
+			_mm256_mul_ps(ry, ry));
+      s = _mm256_add_ps(s, e);
+
+      /* s = m[j]/sqrtv(s*s*s); */
+      s = _mm256_mul_ps(s, _mm256_mul_ps(s, s));
+      s = _mm256_mul_ps(rsqrt_avx(s, mode), _mm256_load_ps(&m[j*LANES]));
+      s = _mm256_mul_ps(g, s);
+
+      axi = _mm256_add_ps(axi, _mm256_mul_ps(rx, s));
+      ayi = _mm256_add_ps(ayi, _mm256_mul_ps(ry, s));
+    }
+
+    a1x[i] = axi;
+    a1y[i] = ayi;
+  }
+
+  for (i = 0; i < BODIES; i++) {
+    __m256 dvx, dvy;
+
+    /* vx[i] += value_literal(0.5)*(a0x[i]+a1x[i])*dt; */
+    dvx = _mm256_mul_ps(h, _mm256_add_ps(_mm256_load_ps(&ax[i*LANES]), a1x[i]));
+    dvy = _mm256_mul_ps(h, _mm256_add_ps(_mm256_load_ps(&ay[i*LANES]), a1y[i]));
+
+    _mm256_store_ps(&vx[i*LANES], _mm256_add_ps(dvx, _mm256_load_ps(&vx[i*LANES])));
+    _mm256_store_ps(&vy[i*LANES], _mm256_add_ps(dvy, _mm256_load_ps(&vy[i*LANES])));
+
+    _mm256_store_ps(&ax[i*LANES], a1x[i]);
+    _mm256_store_ps(&ay[i*LANES], a1y[i]);
+  }
+}
+
+/* total energy of each of the LANES systems of a block, with the
+   same softened potential the forces derive from */
+static void ensemble_energy (const value * x, const value * y,
+			     const value * vx, const value * vy,
+			     const value * m, double * energy) {
+  __m256 e = _mm256_set1_ps(SOFTENING*SOFTENING);
+  __m256 k = _mm256_setzero_ps();
+  __m256 u = _mm256_setzero_ps();
+  value ke[LANES], ue[LANES];
+  size_t i, j, l;
+
+  for (i = 0; i < BODIES; i++) {
+    __m256 vxi = _mm256_load_ps(&vx[i*LANES]);
+    __m256 vyi = _mm256_load_ps(&vy[i*LANES]);
+    __m256 mi = _mm256_load_ps(&m[i*LANES]);
+    __m256 v2 = _mm256_add_ps(_mm256_mul_ps(vxi, vxi),
+			      _mm256_mul_ps(vyi, vyi));
+
+    k = _mm256_add_ps(k, _mm256_mul_ps(mi, v2));
+
+    for (j = i+1; j < BODIES; j++) {
+      __m256 rx = _mm256_sub_ps(_mm256_load_ps(&x[j*LANES]),
+				_mm256_load_ps(&x[i*LANES]));
+      __m256 ry = _mm256_sub_ps(_mm256_load_ps(&y[j*LANES]),
+				_mm256_load_ps(&y[i*LANES]));
+      __m256 s;
+
+      s = _mm256_add_ps(_mm256_mul_ps(rx, rx),
+			_mm256_mul_ps(ry, ry));
+      s = _mm256_div_ps(_mm256_load_ps(&m[j*LANES]),
+			_mm256_sqrt_ps(_mm256_add_ps(s, e)));
+
+      u = _mm256_add_ps(u, _mm256_mul_ps(mi, s));
+    }
+  }
+
+  _mm256_storeu_ps(ke, k);
+  _mm256_storeu_ps(ue, u);
+
+  for (l = 0; l < LANES; l++)
+    energy[l] = 0.5*ke[l] - G*ue[l];
+}
+
+static int ensemble_compare (const void * a, const void * b) {
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+
+  return (x > y) - (x < y);
+}
+
+/* summary of the per system diagnostics of the finished run */
+static void ensemble_report (void) {
+  double * sorted;
+  size_t s, worst = 0;
+
+  if (!measured || systems == 0)
+    return;
+
+  sorted = malloc(systems*sizeof(double));
+
+  if (sorted == NULL) {
+    perror(__func__);
+    exit(EXIT_FAILURE);
+  }
+
+  for (s = 0; s < systems; s++) {
+    sorted[s] = energy_error[s];
+
+    if (energy_error[s] > energy_error[worst])
+      worst = s;
+  }
+
+  qsort(sorted, systems, sizeof(double), ensemble_compare);
+
+  printf("%zu systems of %d bodies, relative energy error "
+	 "median %g, worst %g in system %zu\n",
+	 systems, BODIES, sorted[systems/2], energy_error[worst], worst);
+
+  free(sorted);
+}
+
+void physics_advance (value dt, size_t n,
+		      value * px, value * py,
+		      value * vx, value * vy,
+		      value * m) {
+  physics_advance_n(1, dt, n, px, py, vx, vy, m);
+}
+
+void physics_advance_n (unsigned int k, value dt, size_t n,
+			value * px, value * py,
+			value * vx, value * vy,
+			value * m) {
+  size_t b;
+
+  NBODY_OMP_FOR_NOWAIT
+  for (b = 0; b < blocks; b++) {
+    size_t o = b*BODIES*LANES;
+    double energy[LANES];
+    unsigned int step;
+    size_t l;
+
+    ensemble_gather(b, n, px, py, vx, vy, m);
+
+    if (!measured)
+      ensemble_energy(&ex[o], &ey[o], &evx[o], &evy[o], &em[o],
+		      &energy0[b*LANES]);
+
+    for (step = 0; step < k; step++)
+      ensemble_step(dt, &ex[o], &ey[o], &evx[o], &evy[o], &em[o],
+		    &eax[o], &eay[o]);
+
+    ensemble_energy(&ex[o], &ey[o], &evx[o], &evy[o], &em[o], energy);
+
+    for (l = 0; l < LANES; l++) {
+      double * e0 = &energy0[b*LANES + l];
+      double error = *e0 != 0.0 ? fabs((energy[l] - *e0)/ *e0) : 0.0;
+
+      if (error > energy_error[b*LANES + l])
+	energy_error[b*LANES + l] = error;
+    }
+
+    ensemble_scatter(b, n, px, py, vx, vy);
+  }
+
+  /* the particles are read as soon as this returns */
+  NBODY_OMP_BARRIER
+
+  NBODY_OMP_MASTER
+  measured = 1;
+}
+
+int physics_diagnose (void) {
+  /* the systems are independent, their energies are tracked apart
+     and summarised by ensemble_report instead */
+  return 0;
+}
+
+void physics_diagnostics (double * d) {
+  (void) d;
+}
+
+void physics_free (void) {
+  ensemble_report();
+
+  free(energy_error);
+  free(energy0);
+
+  align_free(tay);
+  align_free(tax);
+  align_free(eay);
+  align_free(eax);
+  align_free(em);
+  align_free(evy);
+  align_free(evx);
+  align_free(ey);
+  align_free(ex);
+}
+
+void physics_init (size_t n) {
+  size_t size;
+
+  systems = (n + BODIES-1)/BODIES;
+  blocks = (systems + LANES-1)/LANES;
+  size = blocks*BODIES*LANES*sizeof(value);
+
+  ex  = align_malloc(ALIGN_BOUNDARY, size);
+  ey  = align_malloc(ALIGN_BOUNDARY, size);
+  evx = align_malloc(ALIGN_BOUNDARY, size);
+  evy = align_malloc(ALIGN_BOUNDARY, size);
+  em  = align_malloc(ALIGN_BOUNDARY, size);
+  eax = align_malloc(ALIGN_BOUNDARY, size);
+  eay = align_malloc(ALIGN_BOUNDARY, size);
+  tax = align_malloc(ALIGN_BOUNDARY, size);
+  tay = align_malloc(ALIGN_BOUNDARY, size);
+
+  energy0 = malloc(blocks*LANES*sizeof(double));
+  energy_error = malloc(blocks*LANES*sizeof(double));
+
+  if (ex == NULL || ey == NULL || evx == NULL || evy == NULL ||
+      em == NULL || eax == NULL || eay == NULL ||
+      tax == NULL || tay == NULL ||
+      energy0 == NULL || energy_error == NULL) {
+    perror(__func__);
+    exit(EXIT_FAILURE);
+  }
+
+  measured = 0;
+
+  physics_reset(n);
+}
+
+void physics_merge (size_t n, const size_t * into, const value * m) {
+  size_t i;
+
+  /* a merger would move every later particle to another system */
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++) {
+    if (into[i] != n) {
+      fprintf(stderr, "%s: systems can not merge particles\n", __func__);
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+void physics_reorder (size_t n, const size_t * order) {
+  value * t;
+  size_t i;
+
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++) {
+    tax[ensemble_index(i)] = eax[ensemble_index(order[i])];
+    tay[ensemble_index(i)] = eay[ensemble_index(order[i])];
+  }
+
+  NBODY_OMP_MASTER
+  {
+    t = eax;
+    eax = tax;
+    tax = t;
+
+    t = eay;
+    eay = tay;
+    tay = t;
+  }
+
+  NBODY_OMP_BARRIER
+    ;
+}
+
+void physics_reset (size_t n) {
+  size_t i;
+
+  ensemble_report();
+
+  NBODY_OMP_PARALLEL_FOR
+  for (i = 0; i < blocks*BODIES*LANES; i++) {
+    eax[i] = value_literal(0.0);
+    eay[i] = value_literal(0.0);
+  }
+
+  for (i = 0; i < blocks*LANES; i++)
+    energy_error[i] = 0.0;
+
+  measured = 0;
+}
@@ -0,0 +1,16 @@
+# systems must stay together, see ensemble.h, so particles are neither
+# reordered nor merged or taken out, which would shift them across systems
+CPPFLAGS += -DVECTOR_SIZE=2 -DALIGN_BOUNDARY=32 -DALLOC_PADDING=32 -DREORDER_INTERVAL=0
+CPPFLAGS += -DCOLLISION_INTERVAL=0 -DESCAPE_INTERVAL=0
+CPPFLAGS += -DPHYSICS_RSQRT=RSQRT_NEWTON
+CFLAGS += -mavx
+
+OMPFLAGS = -fopenmp
+CFLAGS  += $(OMPFLAGS)
+LDFLAGS += $(OMPFLAGS)
+
+physics.o : physics.c
+	$(CC) $(CPPFLAGS) $(CFLAGS) -Wno-unused-parameter -c -o $@ $<
+
+OBJS += rsqrt.o
+DEPS += rsqrt.d
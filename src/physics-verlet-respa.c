@@ -0,0 +1,475 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "align_malloc.h"
+#include "nbody.h"
+#include "nbody-openmp.h"
+
+#include "physics-verlet-respa.h"
+
+/* reordering and the compaction after collisions and escapes move
+   particles between slots and cells, so they may only happen when
+   the cells are rebuilt anyway */
+#if REORDER_INTERVAL % RESPA_STEPS
+#error "REORDER_INTERVAL must be a multiple of RESPA_STEPS"
+#endif
+
+#if COLLISION_INTERVAL % RESPA_STEPS
+#error "COLLISION_INTERVAL must be a multiple of RESPA_STEPS"
+#endif
+
+#if ESCAPE_INTERVAL % RESPA_STEPS
+#error "ESCAPE_INTERVAL must be a multiple of RESPA_STEPS"
+#endif
+
+static const value G = GRAVITATIONAL_CONSTANT;
+
+/* near accelerations, a0 of the last step and a1 of this one */
+static value * a0x = NULL;
+static value * a0y = NULL;
+
+static value * a1x = NULL;
+static value * a1y = NULL;
+
+/* cell of every particle and the particles sorted by cell, cell c
+   holds items[start[c]] up to items[start[c+1]-1] */
+static size_t * cell = NULL;
+static size_t * items = NULL;
+static size_t * start = NULL;
+
+/* mass, center of mass and quadrupole moments of every cell */
+static value * cell_m = NULL;
+static value * cell_x = NULL;
+static value * cell_y = NULL;
+
+static value * cell_qxx = NULL;
+static value * cell_qxy = NULL;
+static value * cell_qyy = NULL;
+
+static size_t grid;
+
+/* steps into the current far interval, and whether the far part has
+   been kicked in before. read by every thread when a batch starts
+   and written by the master when it ends */
+static unsigned int phase;
+static int started;
+
+static size_t physics_grid (size_t n) {
+  size_t g = ceil(sqrt((double) n/RESPA_CELL_PARTICLES));
+
+  if (g < 1)
+    return 1;
+
+  return g < RESPA_GRID_MAX ? g : RESPA_GRID_MAX;
+}
+
+/* sorts the particles into cells, counting sort so the order within
+   a cell is the slot order */
+static void physics_cells (size_t n,
+			   const value * px, const value * py,
+			   const value * m) {
+  value b[4];
+  double sx, sy;
+  size_t i, c, cells = grid*grid;
+
+  b[0] = b[1] = HUGE_VALF;
+  b[2] = b[3] = -HUGE_VALF;
+
+  for (i = 0; i < n; i++) {
+    if (px[i] < b[0]) b[0] = px[i];
+    if (py[i] < b[1]) b[1] = py[i];
+    if (px[i] > b[2]) b[2] = px[i];
+    if (py[i] > b[3]) b[3] = py[i];
+  }
+
+  /* the largest coordinate still falls in the last cell */
+  sx = b[2] > b[0] ? (grid - 0.5)/((double) b[2] - b[0]) : 0.0;
+  sy = b[3] > b[1] ? (grid - 0.5)/((double) b[3] - b[1]) : 0.0;
+
+  for (c = 0; c <= cells; c++)
+    start[c] = 0;
+
+  for (i = 0; i < n; i++) {
+    size_t x = (px[i] - b[0])*sx;
+    size_t y = (py[i] - b[1])*sy;
+
+    cell[i] = y*grid + x;
+    start[cell[i] + 1] += 1;
+  }
+
+  for (c = 0; c < cells; c++)
+    start[c + 1] += start[c];
+
+  for (i = 0; i < n; i++)
+    items[start[cell[i]]++] = i;
+
+  /* the scatter advanced every start to the next cell's */
+  for (c = cells; c > 0; c--)
+    start[c] = start[c - 1];
+  start[0] = 0;
+
+  for (c = 0; c < cells; c++) {
+    value M = value_literal(0.0);
+    value x = value_literal(0.0);
+    value y = value_literal(0.0);
+    size_t k;
+
+    for (k = start[c]; k < start[c + 1]; k++) {
+      M += m[items[k]];
+      x += m[items[k]]*px[items[k]];
+      y += m[items[k]]*py[items[k]];
+    }
+
+    if (M > value_literal(0.0)) {
+      x /= M;
+      y /= M;
+    }
+
+    cell_m[c] = M;
+    cell_x[c] = x;
+    cell_y[c] = y;
+
+    cell_qxx[c] = value_literal(0.0);
+    cell_qxy[c] = value_literal(0.0);
+    cell_qyy[c] = value_literal(0.0);
+
+    /* about the center of mass, in the plane z = 0 */
+    for (k = start[c]; k < start[c + 1]; k++) {
+      value dx = px[items[k]] - x;
+      value dy = py[items[k]] - y;
+
+      cell_qxx[c] += m[items[k]]*(2*dx*dx - dy*dy);
+      cell_qxy[c] += m[items[k]]*(3*dx*dy);
+      cell_qyy[c] += m[items[k]]*(2*dy*dy - dx*dx);
+    }
+  }
+}
+
+/* the far kick, every cell that is not a neighbour expanded to its
+   quadrupole about its center of mass */
+static void physics_far (value dt, size_t n,
+			 const value * px, const value * py,
+			 value * vx, value * vy) {
+  size_t i;
+
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < n; i++) {
+    size_t x = cell[i]%grid;
+    size_t y = cell[i]/grid;
+    value ax = value_literal(0.0);
+    value ay = value_literal(0.0);
+    size_t c;
+
+    for (c = 0; c < grid*grid; c++) {
+      value r[VECTOR_SIZE], q[VECTOR_SIZE];
+      value s, s2, rqr;
+
+      if (cell_m[c] == value_literal(0.0) ||
+	  (c%grid + RESPA_NEAR >= x && c%grid <= x + RESPA_NEAR &&
+	   c/grid + RESPA_NEAR >= y && c/grid <= y + RESPA_NEAR))
+	continue;
+
+      r[0] = cell_x[c] - px[i];
+      r[1] = cell_y[c] - py[i];
+
+      s2 = value_literal(1.0)/
+	((r[0]*r[0] + r[1]*r[1]) + SOFTENING*SOFTENING);
+      s = sqrtv(s2)*s2;
+
+      q[0] = cell_qxx[c]*r[0] + cell_qxy[c]*r[1];
+      q[1] = cell_qxy[c]*r[0] + cell_qyy[c]*r[1];
+      rqr = r[0]*q[0] + r[1]*q[1];
+
+      /* G M r/|r|^3 + G (5/2 (r Q r) r/|r|^7 - Q r/|r|^5), with r
+	 pointing at the cell */
+      ax += G*(cell_m[c]*r[0]*s +
+	       (value_literal(2.5)*rqr*r[0]*s2 - q[0])*s*s2);
+      ay += G*(cell_m[c]*r[1]*s +
+	       (value_literal(2.5)*rqr*r[1]*s2 - q[1])*s*s2);
+    }
+
+    vx[i] += ax*dt;
+    vy[i] += ay*dt;
+  }
+}
+
+/* the near accelerations, from the particles of the cells up to
+   RESPA_NEAR cells away from each particle's own */
+static void physics_near (size_t n,
+			  const value * px, const value * py,
+			  const value * m,
+			  value * a1x, value * a1y) {
+  size_t i;
+
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < n; i++) {
+    size_t x = cell[i]%grid;
+    size_t y = cell[i]/grid;
+    size_t x0 = x > RESPA_NEAR ? x - RESPA_NEAR : 0;
+    size_t y0 = y > RESPA_NEAR ? y - RESPA_NEAR : 0;
+    size_t x1 = x + RESPA_NEAR < grid ? x + RESPA_NEAR : grid - 1;
+    size_t y1 = y + RESPA_NEAR < grid ? y + RESPA_NEAR : grid - 1;
+    value ax = value_literal(0.0);
+    value ay = value_literal(0.0);
+    size_t cx, cy, k;
+
+    for (cy = y0; cy <= y1; cy++) {
+      for (cx = x0; cx <= x1; cx++) {
+	size_t c = cy*grid + cx;
+
+	for (k = start[c]; k < start[c + 1]; k++) {
+	  size_t j = items[k];
+	  value r[VECTOR_SIZE];
+	  value s;
+
+	  r[0] = px[j] - px[i];
+	  r[1] = py[j] - py[i];
+
+	  s = (r[0]*r[0] + r[1]*r[1]) + SOFTENING*SOFTENING;
+	  s = s*s*s;
+	  s = value_literal(1.0)/sqrtv(s);
+
+	  s = s*m[j];
+
+	  ax += G*r[0]*s;
+	  ay += G*r[1]*s;
+	}
+      }
+    }
+
+    a1x[i] = ax;
+    a1y[i] = ay;
+  }
+}
+
+/* a single step, reads the near accelerations a0 and writes a1.
+   starts a far interval with a kick of far times dt unless far is
+   0 */
+static void physics_step (value dt, size_t n,
+			  value * px, value * py,
+			  value * vx, value * vy,
+			  value * m,
+			  value * a0x, value * a0y,
+			  value * a1x, value * a1y,
+			  value far) {
+  size_t i;
+
+  if (far != value_literal(0.0)) {
+    NBODY_OMP_MASTER
+    physics_cells(n, px, py, m);
+
+    NBODY_OMP_BARRIER
+
+    physics_far(far*dt, n, px, py, vx, vy);
+  }
+
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < n; i++) {
+    px[i] +=
+      (vx[i] + value_literal(0.5)*a0x[i]*dt)*dt;
+    py[i] +=
+      (vy[i] + value_literal(0.5)*a0y[i]*dt)*dt;
+  }
+
+  /* forces need every position */
+  NBODY_OMP_BARRIER
+
+  physics_near(n, px, py, m, a1x, a1y);
+
+  /* scheduled like the forces, so every thread only reads the
+     accelerations it wrote itself */
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < n; i++) {
+    vx[i] += value_literal(0.5)*(a0x[i]+a1x[i])*dt;
+    vy[i] += value_literal(0.5)*(a0y[i]+a1y[i])*dt;
+  }
+
+  /* the next step moves particles the forces may still be reading */
+  NBODY_OMP_BARRIER
+}
+
+static void physics_swap (void) {
+  value * tx;
+  value * ty;
+
+  tx = a0x;
+  a0x = a1x;
+  a1x = tx;
+
+  ty = a0y;
+  a0y = a1y;
+  a1y = ty;
+}
+
+void physics_advance (value dt, size_t n,
+		      value * px, value * py,
+		      value * vx, value * vy,
+		      value * m) {
+  physics_advance_n(1, dt, n, px, py, vx, vy, m);
+}
+
+void physics_advance_n (unsigned int k, value dt, size_t n,
+			value * px, value * py,
+			value * vx, value * vy,
+			value * m) {
+  /* every thread swaps its own copy of the accelerations between
+     steps, the shared ones are only swapped once at the end */
+  value * b0x = a0x;
+  value * b0y = a0y;
+  value * b1x = a1x;
+  value * b1y = a1y;
+  unsigned int p = phase;
+  int s = started;
+  unsigned int step;
+
+  for (step = 0; step < k; step++) {
+    value far = value_literal(0.0);
+    value * tx;
+    value * ty;
+
+    /* the far kick closes the last interval and opens the next */
+    if (p == 0)
+      far = s ? RESPA_STEPS : RESPA_STEPS/value_literal(2.0);
+
+    physics_step(dt, n, px, py, vx, vy, m, b0x, b0y, b1x, b1y, far);
+
+    p = (p + 1)%RESPA_STEPS;
+    s = 1;
+
+    tx = b0x;
+    b0x = b1x;
+    b1x = tx;
+
+    ty = b0y;
+    b0y = b1y;
+    b1y = ty;
+  }
+
+  NBODY_OMP_MASTER
+  {
+    phase = p;
+    started = s;
+
+    if (k & 1)
+      physics_swap();
+  }
+}
+
+int physics_diagnose (void) {
+  /* far cells pull through their moments, there is no sum over
+     every pair to take the potential energy from */
+  return 0;
+}
+
+void physics_diagnostics (double * d) {
+  (void) d;
+}
+
+void physics_free (void) {
+  align_free(cell_qyy);
+  align_free(cell_qxy);
+  align_free(cell_qxx);
+  align_free(cell_y);
+  align_free(cell_x);
+  align_free(cell_m);
+  align_free(start);
+  align_free(items);
+  align_free(cell);
+  align_free(a1y);
+  align_free(a1x);
+  align_free(a0y);
+  align_free(a0x);
+}
+
+void physics_init (size_t n) {
+  size_t cells;
+
+  grid = physics_grid(n);
+  cells = grid*grid;
+
+  a0x = align_malloc(ALIGN_BOUNDARY, n*sizeof(value));
+  a0y = align_malloc(ALIGN_BOUNDARY, n*sizeof(value));
+  a1x = align_malloc(ALIGN_BOUNDARY, n*sizeof(value));
+  a1y = align_malloc(ALIGN_BOUNDARY, n*sizeof(value));
+
+  cell = align_malloc(ALIGN_BOUNDARY, n*sizeof(size_t));
+  items = align_malloc(ALIGN_BOUNDARY, n*sizeof(size_t));
+  start = align_malloc(ALIGN_BOUNDARY, (cells + 1)*sizeof(size_t));
+
+  cell_m = align_malloc(ALIGN_BOUNDARY, cells*sizeof(value));
+  cell_x = align_malloc(ALIGN_BOUNDARY, cells*sizeof(value));
+  cell_y = align_malloc(ALIGN_BOUNDARY, cells*sizeof(value));
+
+  cell_qxx = align_malloc(ALIGN_BOUNDARY, cells*sizeof(value));
+  cell_qxy = align_malloc(ALIGN_BOUNDARY, cells*sizeof(value));
+  cell_qyy = align_malloc(ALIGN_BOUNDARY, cells*sizeof(value));
+
+  if (a0x == NULL || a0y == NULL || a1x == NULL || a1y == NULL ||
+      cell == NULL || items == NULL || start == NULL ||
+      cell_m == NULL || cell_x == NULL || cell_y == NULL ||
+      cell_qxx == NULL || cell_qxy == NULL || cell_qyy == NULL) {
+    perror(__func__);
+    exit(EXIT_FAILURE);
+  }
+
+  physics_reset(n);
+}
+
+void physics_merge (size_t n, const size_t * into, const value * m) {
+  size_t i;
+
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++) {
+    size_t j = into[i];
+    value M;
+
+    if (j == n)
+      continue;
+
+    M = m[i] + m[j];
+
+    if (M > value_literal(0.0)) {
+      a0x[i] = (m[i]*a0x[i] + m[j]*a0x[j])/M;
+      a0y[i] = (m[i]*a0y[i] + m[j]*a0y[j])/M;
+    }
+  }
+}
+
+void physics_reorder (size_t n, const size_t * order) {
+  size_t i;
+
+  /* a1 is scratch between steps. this only happens at the start of
+     a far interval, see above, so the step that follows rebuilds the
+     cells on a grid for the particles that are left. */
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++) {
+    a1x[i] = a0x[order[i]];
+    a1y[i] = a0y[order[i]];
+  }
+
+  NBODY_OMP_MASTER
+  {
+    physics_swap();
+    grid = physics_grid(n);
+  }
+
+  NBODY_OMP_BARRIER
+    ;
+}
+
+void physics_reset (size_t n) {
+  size_t i;
+
+  NBODY_OMP_PARALLEL_FOR
+  for (i = 0; i < n; i++) {
+    a0x[i] = 0;
+    a0y[i] = 0;
+    a1x[i] = 0;
+    a1y[i] = 0;
+  }
+
+  grid = physics_grid(n);
+  phase = 0;
+  started = 0;
+}
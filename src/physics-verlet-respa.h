@@ -0,0 +1,23 @@
+#ifndef PHYSICS_VERLET_RESPA_H
+#define PHYSICS_VERLET_RESPA_H 1
+
+#include "physics.h"
+
+/*
+ * Gravity is split on a grid of cells. Particles in the same or
+ * neighbouring cells pull on each other directly every step, every
+ * other cell only pulls through the expansion of its mass about its
+ * center of mass up to the quadrupole, and that far part is kicked
+ * in once every RESPA_STEPS steps with RESPA_STEPS times the
+ * timestep.
+ *
+ * The cells are rebuilt with the far part, the grid has about
+ * RESPA_CELL_PARTICLES particles per cell and at most RESPA_GRID_MAX
+ * cells per side.
+ */
+#define RESPA_STEPS          8
+#define RESPA_NEAR           1
+#define RESPA_CELL_PARTICLES 8
+#define RESPA_GRID_MAX       256
+
+#endif /* PHYSICS_VERLET_RESPA_H */
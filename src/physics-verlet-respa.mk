@@ -0,0 +1,5 @@
+CPPFLAGS += -DVECTOR_SIZE=2 -DALIGN_BOUNDARY='sizeof(void *)' -DALLOC_PADDING=0
+
+OMPFLAGS = -fopenmp
+CFLAGS  += $(OMPFLAGS)
+LDFLAGS += $(OMPFLAGS)
@@ -0,0 +1,387 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "nbody-openmp.h"
+#include "physics.h"
+
+/* laguerre iterations before the kepler solver gives up */
+#define KEPLER_ITERATIONS 64
+
+static const double G = GRAVITATIONAL_CONSTANT;
+
+/*
+ * Wisdom-Holman mapping in democratic heliocentric coordinates.
+ * The star is the heaviest particle, every other particle has a
+ * position q relative to the star and a velocity u relative to the
+ * center of mass. The hamiltonian splits into
+ *   kepler       every planet around the star alone, solved exactly
+ *   interaction  planet-planet gravity, a kick to u
+ *   jump         the star's motion, a drift of q by the total
+ *                planet momentum over the star's mass
+ * and a step is interaction, jump, kepler, jump, interaction with
+ * the middle three spanning dt. The center of mass drifts freely.
+ *
+ * The state is kept in double precision between calls and only
+ * reloaded from the particles after a reset or a reorder.
+ */
+static size_t planets;
+
+static double * qx;
+static double * qy;
+
+static double * ux;
+static double * uy;
+
+static double * mass;
+
+/* slot of every planet and of the star */
+static size_t * slot;
+static size_t star;
+
+static double m0;
+static double mu;
+
+/* center of mass, position and velocity */
+static double cm[4];
+
+/* drift of the jump step and position of the star, shared between
+   threads */
+static double jump[2];
+static double origin[2];
+
+static int memory_loaded;
+
+/* stumpff functions c2 and c3 */
+static void stumpff (double z, double * c2, double * c3) {
+  if (fabs(z) < 1e-4) {
+    *c2 = 1.0/2.0 - z/24.0 + z*z/720.0;
+    *c3 = 1.0/6.0 - z/120.0 + z*z/5040.0;
+  } else if (z > 0.0) {
+    double s = sqrt(z);
+
+    *c2 = (1.0 - cos(s))/z;
+    *c3 = (s - sin(s))/(z*s);
+  } else {
+    double s = sqrt(-z);
+
+    *c2 = (cosh(s) - 1.0)/(-z);
+    *c3 = (sinh(s) - s)/(-z*s);
+  }
+}
+
+/* moves a particle along its kepler orbit around mu for dt, using
+   universal variables so any eccentricity works */
+static void kepler_drift (double dt, double * x, double * y,
+			  double * vx, double * vy) {
+  double r0 = sqrt(*x * *x + *y * *y);
+  double v2 = *vx * *vx + *vy * *vy;
+  double eta = *x * *vx + *y * *vy;    /* r0 vr0 */
+  double sqrt_mu = sqrt(mu);
+  double alpha, zeta, chi;
+  double c2, c3, r, f, g, fd, gd, nx, ny;
+  int i;
+
+  if (r0 == 0.0 || mu == 0.0) {
+    *x += *vx*dt;
+    *y += *vy*dt;
+    return;
+  }
+
+  alpha = 2.0/r0 - v2/mu;       /* 1/a */
+  zeta  = mu - alpha*mu*r0;     /* mu (1 - alpha r0) */
+  chi   = sqrt_mu*dt/r0;
+
+  /* laguerre's method on the universal kepler equation */
+  for (i = 0; i < KEPLER_ITERATIONS; i++) {
+    double chi2 = chi*chi;
+    double F, dF, ddF, d, delta;
+
+    stumpff(alpha*chi2, &c2, &c3);
+
+    F   = eta/sqrt_mu*chi2*c2 + zeta/mu*chi2*chi*c3 + r0*chi - sqrt_mu*dt;
+    dF  = eta/sqrt_mu*chi*(1.0 - alpha*chi2*c3) + zeta/mu*chi2*c2 + r0;
+    ddF = eta/sqrt_mu*(1.0 - alpha*chi2*c2) + zeta/mu*chi*(1.0 - alpha*chi2*c3);
+
+    d = sqrt(fabs(16.0*dF*dF - 20.0*F*ddF));
+    delta = 5.0*F/(dF > 0.0 ? dF + d : dF - d);
+
+    chi -= delta;
+
+    if (fabs(delta) <= 1e-15*fabs(chi))
+      break;
+  }
+
+  stumpff(alpha*chi*chi, &c2, &c3);
+
+  f = 1.0 - chi*chi/r0*c2;
+  g = dt - chi*chi*chi/sqrt_mu*c3;
+
+  nx = f * *x + g * *vx;
+  ny = f * *y + g * *vy;
+
+  r = sqrt(nx*nx + ny*ny);
+
+  fd = sqrt_mu/(r*r0)*chi*(alpha*chi*chi*c3 - 1.0);
+  gd = 1.0 - chi*chi/r*c2;
+
+  *vx = fd * *x + gd * *vx;
+  *vy = fd * *y + gd * *vy;
+
+  *x = nx;
+  *y = ny;
+}
+
+/* planet-planet gravity, the star is in the kepler part */
+static void physics_interaction (double dt) {
+  size_t i;
+
+  NBODY_OMP_FOR
+  for (i = 0; i < planets; i++) {
+    double ax = 0.0, ay = 0.0;
+    size_t j;
+
+    for (j = 0; j < planets; j++) {
+      double rx = qx[j] - qx[i];
+      double ry = qy[j] - qy[i];
+      double s = rx*rx + ry*ry + SOFTENING*SOFTENING;
+
+      s = mass[j]/(s*sqrt(s));
+
+      ax += rx*s;
+      ay += ry*s;
+    }
+
+    ux[i] += G*ax*dt;
+    uy[i] += G*ay*dt;
+  }
+}
+
+static void physics_jump (double dt) {
+  size_t i;
+
+  NBODY_OMP_MASTER
+  {
+    double px = 0.0, py = 0.0;
+
+    for (i = 0; i < planets; i++) {
+      px += mass[i]*ux[i];
+      py += mass[i]*uy[i];
+    }
+
+    jump[0] = px/m0*dt;
+    jump[1] = py/m0*dt;
+  }
+
+  NBODY_OMP_BARRIER
+
+  NBODY_OMP_FOR
+  for (i = 0; i < planets; i++) {
+    qx[i] += jump[0];
+    qy[i] += jump[1];
+  }
+}
+
+static void physics_kepler (double dt) {
+  size_t i;
+
+  NBODY_OMP_FOR
+  for (i = 0; i < planets; i++)
+    kepler_drift(dt, &qx[i], &qy[i], &ux[i], &uy[i]);
+}
+
+/* from the particles to democratic heliocentric coordinates */
+static void physics_load (size_t n,
+			  const value * px, const value * py,
+			  const value * vx, const value * vy,
+			  const value * m) {
+  double M = 0.0;
+  size_t i, k;
+
+  star = 0;
+
+  for (i = 0; i < n; i++)
+    if (m[i] > m[star])
+      star = i;
+
+  cm[0] = cm[1] = cm[2] = cm[3] = 0.0;
+
+  for (i = 0; i < n; i++) {
+    M += m[i];
+
+    cm[0] += m[i]*(double) px[i];
+    cm[1] += m[i]*(double) py[i];
+    cm[2] += m[i]*(double) vx[i];
+    cm[3] += m[i]*(double) vy[i];
+  }
+
+  m0 = m[star];
+
+  if (m0 <= 0.0) {
+    fprintf(stderr, "%s: no star to orbit\n", __func__);
+    exit(EXIT_FAILURE);
+  }
+
+  cm[0] /= M;
+  cm[1] /= M;
+  cm[2] /= M;
+  cm[3] /= M;
+
+  mu = G*m0;
+
+  for (i = 0, k = 0; i < n; i++) {
+    if (i == star)
+      continue;
+
+    slot[k] = i;
+    mass[k] = m[i];
+
+    qx[k] = (double) px[i] - px[star];
+    qy[k] = (double) py[i] - py[star];
+
+    ux[k] = vx[i] - cm[2];
+    uy[k] = vy[i] - cm[3];
+
+    k += 1;
+  }
+
+  planets = k;
+}
+
+/* and back, the star from the center of mass first */
+static void physics_store (value * px, value * py,
+			   value * vx, value * vy) {
+  size_t i;
+
+  NBODY_OMP_MASTER
+  {
+    double M = m0;
+    double mq[2] = {0.0, 0.0};
+    double mv[2] = {0.0, 0.0};
+
+    for (i = 0; i < planets; i++) {
+      M += mass[i];
+
+      mq[0] += mass[i]*qx[i];
+      mq[1] += mass[i]*qy[i];
+
+      mv[0] += mass[i]*ux[i];
+      mv[1] += mass[i]*uy[i];
+    }
+
+    origin[0] = cm[0] - mq[0]/M;
+    origin[1] = cm[1] - mq[1]/M;
+
+    px[star] = origin[0];
+    py[star] = origin[1];
+
+    vx[star] = cm[2] - mv[0]/m0;
+    vy[star] = cm[3] - mv[1]/m0;
+  }
+
+  NBODY_OMP_BARRIER
+
+  NBODY_OMP_FOR_NOWAIT
+  for (i = 0; i < planets; i++) {
+    px[slot[i]] = origin[0] + qx[i];
+    py[slot[i]] = origin[1] + qy[i];
+
+    vx[slot[i]] = cm[2] + ux[i];
+    vy[slot[i]] = cm[3] + uy[i];
+  }
+}
+
+void physics_advance (value dt, size_t n,
+		      value * px, value * py,
+		      value * vx, value * vy,
+		      value * m) {
+  physics_advance_n(1, dt, n, px, py, vx, vy, m);
+}
+
+void physics_advance_n (unsigned int k, value dt, size_t n,
+			value * px, value * py,
+			value * vx, value * vy,
+			value * m) {
+  unsigned int step;
+
+  NBODY_OMP_MASTER
+  if (!memory_loaded) {
+    physics_load(n, px, py, vx, vy, m);
+    memory_loaded = 1;
+  }
+
+  NBODY_OMP_BARRIER
+
+  for (step = 0; step < k; step++) {
+    physics_interaction(0.5*dt);
+    physics_jump(0.5*dt);
+    physics_kepler(dt);
+    physics_jump(0.5*dt);
+    physics_interaction(0.5*dt);
+  }
+
+  NBODY_OMP_MASTER
+  {
+    cm[0] += cm[2]*k*dt;
+    cm[1] += cm[3]*k*dt;
+  }
+
+  NBODY_OMP_BARRIER
+
+  physics_store(px, py, vx, vy);
+
+  /* the particles are read as soon as this returns */
+  NBODY_OMP_BARRIER
+}
+
+int physics_diagnose (void) {
+  /* the pull of the star is in the exact kepler drifts, not in a
+     sum over pairs the potential energy could be taken from */
+  return 0;
+}
+
+void physics_diagnostics (double * d) {
+  (void) d;
+}
+
+void physics_free (void) {
+  free(slot);
+  free(mass);
+  free(uy);
+  free(ux);
+  free(qy);
+  free(qx);
+}
+
+void physics_init (size_t n) {
+  qx = malloc(n*sizeof(double));
+  qy = malloc(n*sizeof(double));
+  ux = malloc(n*sizeof(double));
+  uy = malloc(n*sizeof(double));
+  mass = malloc(n*sizeof(double));
+  slot = malloc(n*sizeof(size_t));
+
+  if (qx == NULL || qy == NULL || ux == NULL || uy == NULL ||
+      mass == NULL || slot == NULL) {
+    perror(__func__);
+    exit(EXIT_FAILURE);
+  }
+
+  physics_reset(n);
+}
+
+void physics_merge (size_t n, const size_t * into, const value * m) {
+  /* the state is loaded again after the reorder that follows */
+}
+
+void physics_reorder (size_t n, const size_t * order) {
+  /* the star and the slots are found again on the next step */
+  NBODY_OMP_MASTER
+  memory_loaded = 0;
+
+  NBODY_OMP_BARRIER
+}
+
+void physics_reset (size_t n) {
+  memory_loaded = 0;
+}
@@ -0,0 +1,11 @@
+# reordering, merging and taking out particles would reload the double
+# precision state from the particles
+CPPFLAGS += -DVECTOR_SIZE=2 -DALIGN_BOUNDARY='sizeof(void *)' -DALLOC_PADDING=0 -DREORDER_INTERVAL=0
+CPPFLAGS += -DCOLLISION_INTERVAL=0 -DESCAPE_INTERVAL=0
+
+OMPFLAGS = -fopenmp
+CFLAGS  += $(OMPFLAGS)
+LDFLAGS += $(OMPFLAGS)
+
+physics.o : physics.c
+	$(CC) $(CPPFLAGS) $(CFLAGS) -Wno-unused-parameter -c -o $@ $<
@@ -7,18 +7,55 @@
 #define GRAVITATIONAL_CONSTANT        value_literal(1.0)       /* N (m/kg)^2 */ 
 #define SOFTENING                     value_literal(1e-2)      /* m */
 
+/* the diagnostics of a step */
+#define PHYSICS_KINETIC     0    /* kinetic energy */
+#define PHYSICS_POTENTIAL   1    /* potential energy */
+#define PHYSICS_MOMENTUM_X  2
+#define PHYSICS_MOMENTUM_Y  3
+#define PHYSICS_ANGULAR     4    /* angular momentum around 0 */
+#define PHYSICS_VIRIAL      5    /* sum of r.F over all pairs */
+#define PHYSICS_DIAGNOSTICS 6
+
 /* advance time by dt */
 extern void physics_advance (value dt, size_t n,
 			     value * px, value * py,
 			     value * vx, value * vy,
 			     value * m);
 
+/* advance time by k steps of dt, the particles are only brought up
+   to date when all k are done. must be called by every thread. */
+extern void physics_advance_n (unsigned int k, value dt, size_t n,
+			       value * px, value * py,
+			       value * vx, value * vy,
+			       value * m);
+
+/* asks for the diagnostics of the last step of the next
+   physics_advance_n, which the force loops add up along the way.
+   returns 0 when they can not. called by one thread between
+   batches. */
+extern int physics_diagnose (void);
+
+/* the diagnostics asked for, d has PHYSICS_DIAGNOSTICS of them */
+extern void physics_diagnostics (double * d);
+
 /* frees underlying resources */
 extern void physics_free (void);
 
 /* initializes the system to handle n particles */
 extern void physics_init (size_t n);
 
+/* folds the state of the particle in slot into[i] into that of
+   particle i ahead of their merger, into[i] is n when i takes in
+   none. m still holds the masses from before. must be called by
+   every thread. */
+extern void physics_merge (size_t n, const size_t * into,
+			   const value * m);
+
+/* moves the state of the particle in slot order[i] to slot i,
+   must be called by every thread. n is smaller than before when
+   particles were removed, those not in order are gone. */
+extern void physics_reorder (size_t n, const size_t * order);
+
 /* resets the underlying state */
 extern void physics_reset (size_t n);
 
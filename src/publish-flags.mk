@@ -0,0 +1 @@
+publish-none.mk
\ No newline at end of file
@@ -0,0 +1,22 @@
+#include "publish.h"
+
+void publish_free (void) {
+}
+
+void publish_init (size_t n) {
+}
+
+void publish_particles (unsigned long int step,
+			value dt, size_t n,
+			const size_t * id,
+			const value * px, const value * py,
+			const value * vx, const value * vy,
+			const value * m) {
+}
+
+int publish_ready (void) {
+  return 0;
+}
+
+void publish_reset (size_t n) {
+}
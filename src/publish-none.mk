@@ -0,0 +1,2 @@
+publish.o : publish.c
+	$(CC) $(CFLAGS) -Wno-unused-parameter -c -o $@ $<
@@ -0,0 +1,124 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "publish-shm.h"
+
+typedef double ticks;
+
+static inline ticks get_ticks (void) {
+  struct timespec now;
+
+  (void) clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return 1e3*now.tv_sec + 1e-6*now.tv_nsec;
+}
+
+static struct publish_shm_header * header = NULL;
+static size_t header_size;
+
+static uint64_t publish_resets;
+static ticks publish_time;
+
+void publish_free (void) {
+  if (header == NULL)
+    return;
+
+  munmap(header, header_size);
+  shm_unlink(PUBLISH_SHM_NAME);
+
+  header = NULL;
+}
+
+void publish_init (size_t n) {
+  int fd;
+
+  header_size = publish_shm_size(n);
+
+  fd = shm_open(PUBLISH_SHM_NAME, O_CREAT | O_RDWR | O_TRUNC, 0644);
+
+  if (fd < 0) {
+    perror(__func__);
+    exit(EXIT_FAILURE);
+  }
+
+  if (ftruncate(fd, header_size) < 0) {
+    perror(__func__);
+    exit(EXIT_FAILURE);
+  }
+
+  header = mmap(NULL, header_size,
+		PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (header == MAP_FAILED) {
+    perror(__func__);
+    exit(EXIT_FAILURE);
+  }
+
+  header->capacity   = n;
+  header->frames     = PUBLISH_SHM_FRAMES;
+  header->frame_size = publish_shm_frame_size(n);
+  header->value_size = sizeof(value);
+  header->published  = 0;
+
+  /* readers check the magic last */
+  __atomic_store_n(&header->magic, PUBLISH_SHM_MAGIC, __ATOMIC_RELEASE);
+
+  publish_resets = 0;
+}
+
+void publish_particles (unsigned long int step,
+			value dt, size_t n,
+			const size_t * id,
+			const value * px, const value * py,
+			const value * vx, const value * vy,
+			const value * m) {
+  const value * in[PUBLISH_SHM_ARRAYS] = {px, py, vx, vy, m};
+  struct publish_shm_frame * frame;
+  uint64_t sequence;
+  uint64_t * ids;
+  size_t i;
+  int a;
+
+  publish_time = get_ticks();
+
+  frame = publish_shm_frame(header, header->published);
+  sequence = frame->sequence;
+
+  /* odd, readers of this frame back off */
+  __atomic_store_n(&frame->sequence, sequence+1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  frame->step  = step;
+  frame->reset = publish_resets;
+  frame->n     = n;
+  frame->dt    = dt;
+
+  for (a = 0; a < PUBLISH_SHM_ARRAYS; a++)
+    memcpy(publish_shm_array(header, frame, a), in[a], n*sizeof(value));
+
+  ids = publish_shm_id(header, frame);
+
+  for (i = 0; i < n; i++)
+    ids[i] = id[i];
+
+  /* even, frame is complete */
+  __atomic_store_n(&frame->sequence, sequence+2, __ATOMIC_RELEASE);
+  __atomic_store_n(&header->published, header->published+1, __ATOMIC_RELEASE);
+}
+
+int publish_ready (void) {
+  return get_ticks() >= publish_time + 1000/PUBLISH_RATE;
+}
+
+void publish_reset (size_t n) {
+  publish_resets += 1;
+  publish_time = 0;
+}
@@ -0,0 +1,145 @@
+#ifndef PUBLISH_SHM_H
+#define PUBLISH_SHM_H 1
+
+#include <stdint.h>
+#include <string.h>
+
+#include "publish.h"
+
+/*
+ * The shared memory object holds a header followed by a ring of
+ * frames. Each frame starts with a sequence number that is odd
+ * while the simulation writes the frame and even once the frame
+ * is complete, a reader copies a frame and retries if the
+ * sequence number changed underneath it. Readers never write to
+ * the object so any number of them can map it.
+ *
+ * Layout, every block starts on a PUBLISH_SHM_ALIGN boundary,
+ *   header
+ *   frame 0: frame header, px, py, vx, vy, m, id
+ *   frame 1: ...
+ *
+ * The simulation reorders particles in memory, id[i] is the stable
+ * number of the particle in slot i.
+ */
+
+#define PUBLISH_SHM_NAME   "/nbody"
+#define PUBLISH_SHM_MAGIC  UINT64_C(0x6e626f6479736e70) /* "nbodysnp" */
+#define PUBLISH_SHM_ALIGN  64
+#define PUBLISH_SHM_FRAMES 4
+
+#define PUBLISH_RATE       60 /* frames per second */
+
+#define PUBLISH_SHM_ROUND(x) \
+  (((x) + PUBLISH_SHM_ALIGN-1) & ~((uint64_t) PUBLISH_SHM_ALIGN-1))
+
+struct publish_shm_header {
+  uint64_t magic;
+  uint64_t capacity;     /* particles per frame */
+  uint64_t frames;       /* frames in the ring */
+  uint64_t frame_size;   /* bytes per frame including its header */
+  uint64_t value_size;   /* sizeof(value) in the simulation */
+  uint64_t published;    /* number of complete frames so far */
+};
+
+struct publish_shm_frame {
+  uint64_t sequence;     /* odd while being written */
+  uint64_t step;         /* physics iteration */
+  uint64_t reset;        /* simulation the frame belongs to */
+  uint64_t n;            /* particles in this frame */
+  double   dt;
+};
+
+enum {
+  PUBLISH_SHM_PX = 0,
+  PUBLISH_SHM_PY = 1,
+  PUBLISH_SHM_VX = 2,
+  PUBLISH_SHM_VY = 3,
+  PUBLISH_SHM_M  = 4,
+  PUBLISH_SHM_ARRAYS
+};
+
+static inline uint64_t publish_shm_frame_size (uint64_t capacity) {
+  return PUBLISH_SHM_ROUND(sizeof(struct publish_shm_frame)) +
+    PUBLISH_SHM_ARRAYS*PUBLISH_SHM_ROUND(capacity*sizeof(value)) +
+    PUBLISH_SHM_ROUND(capacity*sizeof(uint64_t));
+}
+
+static inline uint64_t publish_shm_size (uint64_t capacity) {
+  return PUBLISH_SHM_ROUND(sizeof(struct publish_shm_header)) +
+    PUBLISH_SHM_FRAMES*publish_shm_frame_size(capacity);
+}
+
+static inline struct publish_shm_frame *
+publish_shm_frame (const struct publish_shm_header * header, uint64_t f) {
+  return (struct publish_shm_frame *)
+    ((char *) header +
+     PUBLISH_SHM_ROUND(sizeof(struct publish_shm_header)) +
+     (f % header->frames)*header->frame_size);
+}
+
+static inline value * publish_shm_array (const struct publish_shm_header * header,
+					 struct publish_shm_frame * frame,
+					 int array) {
+  return (value *)
+    ((char *) frame +
+     PUBLISH_SHM_ROUND(sizeof(struct publish_shm_frame)) +
+     array*PUBLISH_SHM_ROUND(header->capacity*sizeof(value)));
+}
+
+static inline uint64_t * publish_shm_id (const struct publish_shm_header * header,
+					 struct publish_shm_frame * frame) {
+  return (uint64_t *)
+    publish_shm_array(header, frame, PUBLISH_SHM_ARRAYS);
+}
+
+/*
+ * Copies the most recent complete frame into the given arrays,
+ * which must hold header->capacity elements each, arrays that are
+ * NULL are skipped. Returns the number of particles copied or 0 if
+ * nothing was published yet. For use by viewer and analysis
+ * processes.
+ */
+static inline uint64_t publish_shm_read (const struct publish_shm_header * header,
+					 struct publish_shm_frame * meta,
+					 value * px, value * py,
+					 value * vx, value * vy,
+					 value * m, uint64_t * id) {
+  value * out[PUBLISH_SHM_ARRAYS] = {px, py, vx, vy, m};
+
+  for (;;) {
+    uint64_t published, s0, s1;
+    struct publish_shm_frame * frame;
+    int a;
+
+    published = __atomic_load_n(&header->published, __ATOMIC_ACQUIRE);
+
+    if (published == 0)
+      return 0;
+
+    frame = publish_shm_frame(header, published-1);
+
+    s0 = __atomic_load_n(&frame->sequence, __ATOMIC_ACQUIRE);
+
+    if (s0 & 1)
+      continue;
+
+    *meta = *frame;
+
+    for (a = 0; a < PUBLISH_SHM_ARRAYS; a++)
+      if (out[a] != NULL)
+	memcpy(out[a], publish_shm_array(header, frame, a),
+	       meta->n*sizeof(value));
+
+    if (id != NULL)
+      memcpy(id, publish_shm_id(header, frame), meta->n*sizeof(uint64_t));
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    s1 = __atomic_load_n(&frame->sequence, __ATOMIC_RELAXED);
+
+    if (s0 == s1)
+      return meta->n;
+  }
+}
+
+#endif /* PUBLISH_SHM_H */
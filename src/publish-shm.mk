@@ -0,0 +1,3 @@
+LDLIBS += -lrt
+publish.o : publish.c
+	$(CC) $(CFLAGS) -Wno-unused-parameter -c -o $@ $<
@@ -0,0 +1,474 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "publish-tcp.h"
+
+typedef double ticks;
+
+static inline ticks get_ticks (void) {
+  struct timespec now;
+
+  (void) clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return 1e3*now.tv_sec + 1e-6*now.tv_nsec;
+}
+
+/* snapshot handed from the simulation to the server thread */
+struct snapshot {
+  unsigned long int reset;
+  unsigned long int step;
+  size_t n;
+  size_t * id;
+  value * px;
+  value * py;
+};
+
+/*
+ * Triple buffer, the simulation fills spare and swaps it with
+ * ready, the server swaps ready with its own. The lock is only
+ * held for the swaps.
+ */
+static struct snapshot snapshots[3];
+static struct snapshot * spare;
+static struct snapshot * ready;
+static struct snapshot * server;
+static bool fresh;
+static pthread_mutex_t snapshot_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct client {
+  int fd;
+
+  size_t subsample;
+  float region[4];
+  bool key;
+  unsigned long int reset;
+
+  /* previously sent quantised positions */
+  uint16_t * qx;
+  uint16_t * qy;
+
+  /* pending output */
+  unsigned char * out;
+  size_t out_len;
+  size_t out_off;
+
+  /* partial command line */
+  char in[128];
+  size_t in_len;
+};
+
+static struct client clients[PUBLISH_TCP_CLIENTS];
+
+static size_t capacity;
+
+/* slot of every particle in the server's snapshot */
+static size_t * slot;
+static int listen_fd = -1;
+static int wake_fd[2] = {-1, -1};
+static pthread_t thread;
+static volatile bool quit;
+
+static unsigned long int publish_resets;
+static ticks publish_time;
+
+static void publish_die (const char * func) {
+  perror(func);
+  exit(EXIT_FAILURE);
+}
+
+static inline uint16_t publish_quantise (value x, float x0, float x1) {
+  float q = (x - x0)/(x1 - x0);
+
+  if (!(q >= 0.0f && q <= 1.0f))
+    return PUBLISH_TCP_OUTSIDE;
+
+  return (uint16_t) lrintf(q*PUBLISH_TCP_QMAX);
+}
+
+static inline unsigned char * publish_varint (unsigned char * p, int32_t d) {
+  uint32_t z = ((uint32_t) d << 1) ^ (uint32_t) (d >> 31);
+
+  while (z >= 0x80) {
+    *p++ = (unsigned char) (z | 0x80);
+    z >>= 7;
+  }
+  *p++ = (unsigned char) z;
+
+  return p;
+}
+
+static void publish_client_close (struct client * c) {
+  close(c->fd);
+  c->fd = -1;
+}
+
+static void publish_client_accept (void) {
+  int fd, i;
+
+  fd = accept(listen_fd, NULL, NULL);
+
+  if (fd < 0)
+    return;
+
+  for (i = 0; i < PUBLISH_TCP_CLIENTS; i++)
+    if (clients[i].fd < 0)
+      break;
+
+  if (i == PUBLISH_TCP_CLIENTS) {
+    close(fd);
+    return;
+  }
+
+  (void) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  clients[i].fd = fd;
+  clients[i].subsample = 1;
+  clients[i].region[0] = -2.0f;
+  clients[i].region[1] = -2.0f;
+  clients[i].region[2] =  2.0f;
+  clients[i].region[3] =  2.0f;
+  clients[i].key = true;
+  clients[i].reset = 0;
+  clients[i].out_len = 0;
+  clients[i].out_off = 0;
+  clients[i].in_len = 0;
+}
+
+static void publish_client_command (struct client * c, const char * line) {
+  unsigned long int k;
+  float r[4];
+
+  if (sscanf(line, "subsample %lu", &k) == 1 && k > 0) {
+    c->subsample = k;
+    c->key = true;
+  } else if (sscanf(line, "region %f %f %f %f",
+		    &r[0], &r[1], &r[2], &r[3]) == 4 &&
+	     r[2] > r[0] && r[3] > r[1]) {
+    memcpy(c->region, r, sizeof(r));
+    c->key = true;
+  }
+}
+
+static void publish_client_read (struct client * c) {
+  ssize_t len;
+  char * nl;
+
+  len = recv(c->fd, c->in + c->in_len, sizeof(c->in) - 1 - c->in_len, 0);
+
+  if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR)) {
+    publish_client_close(c);
+    return;
+  }
+
+  if (len < 0)
+    return;
+
+  c->in_len += len;
+  c->in[c->in_len] = '\0';
+
+  while ((nl = strchr(c->in, '\n')) != NULL) {
+    *nl = '\0';
+    publish_client_command(c, c->in);
+
+    c->in_len -= nl + 1 - c->in;
+    memmove(c->in, nl + 1, c->in_len + 1);
+  }
+
+  /* overlong line, drop it */
+  if (c->in_len == sizeof(c->in) - 1)
+    c->in_len = 0;
+}
+
+static void publish_client_write (struct client * c) {
+  ssize_t len;
+
+  len = send(c->fd, c->out + c->out_off, c->out_len - c->out_off,
+	     MSG_NOSIGNAL);
+
+  if (len < 0) {
+    if (errno != EAGAIN && errno != EINTR)
+      publish_client_close(c);
+    return;
+  }
+
+  c->out_off += len;
+
+  if (c->out_off == c->out_len)
+    c->out_off = c->out_len = 0;
+}
+
+static void publish_client_encode (struct client * c,
+				   const struct snapshot * s) {
+  struct publish_tcp_frame frame;
+  unsigned char * p = c->out + sizeof(frame);
+  size_t i, j;
+
+  /* new simulation, start over from a key frame */
+  if (c->reset != s->reset) {
+    c->reset = s->reset;
+    c->key = true;
+  }
+
+  if (c->key) {
+    memset(c->qx, 0, capacity*sizeof(uint16_t));
+    memset(c->qy, 0, capacity*sizeof(uint16_t));
+  }
+
+  for (i = 0, j = 0; i < capacity; i += c->subsample, j++) {
+    uint16_t qx = PUBLISH_TCP_OUTSIDE;
+    uint16_t qy = PUBLISH_TCP_OUTSIDE;
+
+    if (slot[i] < s->n) {
+      qx = publish_quantise(s->px[slot[i]], c->region[0], c->region[2]);
+      qy = publish_quantise(s->py[slot[i]], c->region[1], c->region[3]);
+    }
+
+    p = publish_varint(p, (int32_t) qx - c->qx[j]);
+    p = publish_varint(p, (int32_t) qy - c->qy[j]);
+
+    c->qx[j] = qx;
+    c->qy[j] = qy;
+  }
+
+  frame.magic     = PUBLISH_TCP_MAGIC;
+  frame.flags     = c->key ? PUBLISH_TCP_KEY_FRAME : 0;
+  frame.step      = s->step;
+  frame.count     = j;
+  frame.subsample = c->subsample;
+  memcpy(frame.region, c->region, sizeof(frame.region));
+  frame.size      = p - (c->out + sizeof(frame));
+  frame.reserved  = 0;
+
+  memcpy(c->out, &frame, sizeof(frame));
+
+  c->out_len = p - c->out;
+  c->out_off = 0;
+  c->key = false;
+}
+
+static void * publish_server (void * arg) {
+  struct pollfd fds[2 + PUBLISH_TCP_CLIENTS];
+  int i;
+
+  (void) arg;
+
+  while (!quit) {
+    bool frame = false;
+    char drain[64];
+
+    fds[0].fd = listen_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = wake_fd[0];
+    fds[1].events = POLLIN;
+
+    for (i = 0; i < PUBLISH_TCP_CLIENTS; i++) {
+      fds[2+i].fd = clients[i].fd;
+      fds[2+i].events = POLLIN | (clients[i].out_len ? POLLOUT : 0);
+      fds[2+i].revents = 0;
+    }
+
+    if (poll(fds, 2 + PUBLISH_TCP_CLIENTS, -1) < 0)
+      continue;
+
+    if (fds[0].revents & POLLIN)
+      publish_client_accept();
+
+    if (fds[1].revents & POLLIN) {
+      while (read(wake_fd[0], drain, sizeof(drain)) > 0)
+	;
+
+      pthread_mutex_lock(&snapshot_lock);
+      if (fresh) {
+	struct snapshot * t = ready;
+	ready = server;
+	server = t;
+	fresh = false;
+	frame = true;
+      }
+      pthread_mutex_unlock(&snapshot_lock);
+    }
+
+    if (frame) {
+      size_t k;
+
+      for (k = 0; k < capacity; k++)
+	slot[k] = capacity;
+
+      for (k = 0; k < server->n; k++)
+	slot[server->id[k]] = k;
+    }
+
+    for (i = 0; i < PUBLISH_TCP_CLIENTS; i++) {
+      struct client * c = &clients[i];
+
+      if (c->fd < 0 || fds[2+i].fd < 0)
+	continue;
+
+      if (fds[2+i].revents & (POLLERR | POLLHUP)) {
+	publish_client_close(c);
+	continue;
+      }
+
+      if (fds[2+i].revents & POLLIN)
+	publish_client_read(c);
+
+      if (c->fd >= 0 && (fds[2+i].revents & POLLOUT))
+	publish_client_write(c);
+
+      /* slow clients skip frames */
+      if (c->fd >= 0 && frame && c->out_len == 0) {
+	publish_client_encode(c, server);
+	publish_client_write(c);
+      }
+    }
+  }
+
+  return NULL;
+}
+
+void publish_free (void) {
+  int i;
+
+  quit = true;
+  (void) write(wake_fd[1], "", 1);
+  pthread_join(thread, NULL);
+
+  for (i = 0; i < PUBLISH_TCP_CLIENTS; i++) {
+    if (clients[i].fd >= 0)
+      publish_client_close(&clients[i]);
+
+    free(clients[i].out);
+    free(clients[i].qy);
+    free(clients[i].qx);
+  }
+
+  for (i = 0; i < 3; i++) {
+    free(snapshots[i].py);
+    free(snapshots[i].px);
+    free(snapshots[i].id);
+  }
+
+  free(slot);
+
+  close(wake_fd[1]);
+  close(wake_fd[0]);
+  close(listen_fd);
+}
+
+void publish_init (size_t n) {
+  struct sockaddr_in addr;
+  int i, on = 1;
+
+  capacity = n;
+
+  for (i = 0; i < 3; i++) {
+    snapshots[i].n = 0;
+    snapshots[i].id = malloc(n*sizeof(size_t));
+    snapshots[i].px = malloc(n*sizeof(value));
+    snapshots[i].py = malloc(n*sizeof(value));
+
+    if (snapshots[i].id == NULL ||
+	snapshots[i].px == NULL || snapshots[i].py == NULL)
+      publish_die(__func__);
+  }
+
+  slot = malloc(n*sizeof(size_t));
+
+  if (slot == NULL)
+    publish_die(__func__);
+
+  spare  = &snapshots[0];
+  ready  = &snapshots[1];
+  server = &snapshots[2];
+  fresh  = false;
+
+  for (i = 0; i < PUBLISH_TCP_CLIENTS; i++) {
+    clients[i].fd = -1;
+    clients[i].qx = malloc(n*sizeof(uint16_t));
+    clients[i].qy = malloc(n*sizeof(uint16_t));
+    /* worst case is 3 bytes per quantised coordinate */
+    clients[i].out = malloc(sizeof(struct publish_tcp_frame) + 6*n);
+
+    if (clients[i].qx == NULL || clients[i].qy == NULL ||
+	clients[i].out == NULL)
+      publish_die(__func__);
+  }
+
+  if (pipe(wake_fd) < 0)
+    publish_die(__func__);
+
+  (void) fcntl(wake_fd[0], F_SETFL, O_NONBLOCK);
+  (void) fcntl(wake_fd[1], F_SETFL, O_NONBLOCK);
+
+  listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+  if (listen_fd < 0)
+    publish_die(__func__);
+
+  (void) setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(PUBLISH_TCP_PORT);
+
+  if (bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+      listen(listen_fd, PUBLISH_TCP_CLIENTS) < 0)
+    publish_die(__func__);
+
+  (void) fcntl(listen_fd, F_SETFL, O_NONBLOCK);
+
+  quit = false;
+  publish_resets = 0;
+
+  if (pthread_create(&thread, NULL, publish_server, NULL) != 0)
+    publish_die(__func__);
+}
+
+void publish_particles (unsigned long int step,
+			value dt, size_t n,
+			const size_t * id,
+			const value * px, const value * py,
+			const value * vx, const value * vy,
+			const value * m) {
+  struct snapshot * t;
+
+  publish_time = get_ticks();
+
+  spare->reset = publish_resets;
+  spare->step = step;
+  spare->n = n;
+  memcpy(spare->id, id, n*sizeof(size_t));
+  memcpy(spare->px, px, n*sizeof(value));
+  memcpy(spare->py, py, n*sizeof(value));
+
+  pthread_mutex_lock(&snapshot_lock);
+  t = ready;
+  ready = spare;
+  spare = t;
+  fresh = true;
+  pthread_mutex_unlock(&snapshot_lock);
+
+  (void) write(wake_fd[1], "", 1);
+}
+
+int publish_ready (void) {
+  return get_ticks() >= publish_time + 1000/PUBLISH_RATE;
+}
+
+void publish_reset (size_t n) {
+  publish_resets += 1;
+  publish_time = 0;
+}
@@ -0,0 +1,54 @@
+#ifndef PUBLISH_TCP_H
+#define PUBLISH_TCP_H 1
+
+#include <stdint.h>
+
+#include "publish.h"
+
+/*
+ * Clients connect to PUBLISH_TCP_PORT and may at any time send
+ * newline terminated commands,
+ *   subsample k             stream every k:th particle
+ *   region x0 y0 x1 y1      quantise positions inside the box
+ * Both take effect with the next frame, which is then a key frame.
+ *
+ * The server sends frames, a frame is a publish_tcp_frame header
+ * in little endian followed by size bytes of payload. Particles are
+ * streamed by their stable number, 0, k, 2k and so on, regardless
+ * of where the simulation keeps them in memory. For every streamed
+ * particle the payload holds the x and then the y quantised
+ * position as zigzag varints, relative to the value the client
+ * received in the previous frame, or to 0 in key frames. A
+ * quantised position q maps back to x0 + q*(x1-x0)/QMAX, the value
+ * PUBLISH_TCP_OUTSIDE marks a particle outside the region or one
+ * that no longer exists.
+ *
+ * A client that has not drained the previous frame by the time a
+ * new one is ready skips it, the simulation is never held back.
+ */
+
+#define PUBLISH_TCP_PORT     7451
+#define PUBLISH_TCP_CLIENTS  16
+#define PUBLISH_TCP_MAGIC    UINT32_C(0x6e627466) /* "nbtf" */
+
+#define PUBLISH_TCP_QMAX     UINT16_C(0xfffe)
+#define PUBLISH_TCP_OUTSIDE  UINT16_C(0xffff)
+
+#define PUBLISH_RATE         30 /* frames per second */
+
+enum {
+  PUBLISH_TCP_KEY_FRAME = 1 << 0
+};
+
+struct publish_tcp_frame {
+  uint32_t magic;
+  uint32_t flags;
+  uint64_t step;
+  uint32_t count;       /* particles in the payload */
+  uint32_t subsample;
+  float    region[4];   /* x0 y0 x1 y1 */
+  uint32_t size;        /* payload bytes */
+  uint32_t reserved;
+} __attribute__((packed));
+
+#endif /* PUBLISH_TCP_H */
@@ -0,0 +1,4 @@
+CFLAGS += -pthread
+LDFLAGS += -pthread
+publish.o : publish.c
+	$(CC) $(CFLAGS) -Wno-unused-parameter -c -o $@ $<
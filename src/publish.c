@@ -0,0 +1 @@
+publish-none.c
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef PUBLISH_H
+#define PUBLISH_H 1
+
+#include <stddef.h>
+#include "value.h"
+
+/* frees the publication channel */
+extern void publish_free (void);
+
+/* creates a publication channel for n particles */
+extern void publish_init (size_t n);
+
+/* makes the current state available to other processes */
+extern void publish_particles (unsigned long int step,
+			       value dt, size_t n,
+			       const size_t * id,
+			       const value * px, const value * py,
+			       const value * vx, const value * vy,
+			       const value * m);
+
+/* returns whether it's time to publish or not */
+extern int publish_ready (void);
+
+/* marks the start of a new simulation */
+extern void publish_reset (size_t n);
+
+#endif /* PUBLISH_H */
@@ -0,0 +1,331 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "align_malloc.h"
+#include "nbody-openmp.h"
+#include "physics.h"
+#include "reorder.h"
+
+#define KEY_BITS   32
+#define RADIX_BITS 8
+#define RADIX      (1 << RADIX_BITS)
+#define PASSES     (KEY_BITS/RADIX_BITS)
+
+/* curve resolution per axis, the top bit of a key sorts the
+   massless particles after the massive ones */
+#define GRID_BITS  ((KEY_BITS-2)/2)
+#define GRID_MAX   ((1 << GRID_BITS) - 1)
+#define KEY_TRACER (UINT32_C(1) << (KEY_BITS-1))
+
+/* double buffered keys and slots, PASSES is even so after sorting
+   slots[0][i] is the slot the i:th particle came from */
+static uint32_t * keys[2];
+static size_t * slots[2];
+
+static value * scratch;
+static size_t * scratch_id;
+
+/* per thread digit counts and bounding boxes */
+static size_t (* counts)[RADIX];
+static value (* bounds)[4];
+
+static inline uint32_t reorder_spread (uint32_t x) {
+  x = (x | (x << 8)) & UINT32_C(0x00ff00ff);
+  x = (x | (x << 4)) & UINT32_C(0x0f0f0f0f);
+  x = (x | (x << 2)) & UINT32_C(0x33333333);
+  x = (x | (x << 1)) & UINT32_C(0x55555555);
+
+  return x;
+}
+
+static inline uint32_t reorder_morton (uint32_t x, uint32_t y) {
+  return reorder_spread(x) | (reorder_spread(y) << 1);
+}
+
+static inline uint32_t reorder_hilbert (uint32_t x, uint32_t y) {
+  uint32_t s, d = 0;
+
+  for (s = 1 << (GRID_BITS-1); s > 0; s >>= 1) {
+    uint32_t rx = (x & s) > 0;
+    uint32_t ry = (y & s) > 0;
+
+    d += s * s * ((3 * rx) ^ ry);
+
+    /* rotate the quadrant */
+    if (ry == 0) {
+      uint32_t t;
+
+      if (rx == 1) {
+	x = GRID_MAX - x;
+	y = GRID_MAX - y;
+      }
+
+      t = x;
+      x = y;
+      y = t;
+    }
+  }
+
+  return d;
+}
+
+static inline uint32_t reorder_key (uint32_t x, uint32_t y) {
+#if REORDER_CURVE == REORDER_HILBERT
+  return reorder_hilbert(x, y);
+#else
+  return reorder_morton(x, y);
+#endif
+}
+
+static void reorder_keys (size_t lo, size_t hi,
+			  const value * px, const value * py,
+			  const value * m) {
+  int t, threads = nbody_omp_threads();
+  value b[4];
+  double sx, sy;
+  size_t i;
+
+  b[0] = b[1] = HUGE_VALF;
+  b[2] = b[3] = -HUGE_VALF;
+
+  for (i = lo; i < hi; i++) {
+    if (px[i] < b[0]) b[0] = px[i];
+    if (py[i] < b[1]) b[1] = py[i];
+    if (px[i] > b[2]) b[2] = px[i];
+    if (py[i] > b[3]) b[3] = py[i];
+  }
+
+  t = nbody_omp_thread();
+  bounds[t][0] = b[0];
+  bounds[t][1] = b[1];
+  bounds[t][2] = b[2];
+  bounds[t][3] = b[3];
+
+  NBODY_OMP_BARRIER
+
+  /* every thread reduces in the same order */
+  for (t = 0; t < threads; t++) {
+    if (bounds[t][0] < b[0]) b[0] = bounds[t][0];
+    if (bounds[t][1] < b[1]) b[1] = bounds[t][1];
+    if (bounds[t][2] > b[2]) b[2] = bounds[t][2];
+    if (bounds[t][3] > b[3]) b[3] = bounds[t][3];
+  }
+
+  sx = b[2] > b[0] ? GRID_MAX/((double) b[2] - b[0]) : 0.0;
+  sy = b[3] > b[1] ? GRID_MAX/((double) b[3] - b[1]) : 0.0;
+
+  for (i = lo; i < hi; i++) {
+    uint32_t x = (px[i] - b[0])*sx;
+    uint32_t y = (py[i] - b[1])*sy;
+
+    keys[0][i] = reorder_key(x, y);
+    slots[0][i] = i;
+
+    if (m[i] == value_literal(0.0))
+      keys[0][i] |= KEY_TRACER;
+  }
+}
+
+/*
+ * Least significant digit radix sort. Every thread counts and
+ * scatters its own contiguous range, ranges are laid out in thread
+ * order within each digit so the sort is stable and the result
+ * does not depend on the number of threads.
+ */
+static void reorder_sort (size_t lo, size_t hi) {
+  int t = nbody_omp_thread();
+  int threads = nbody_omp_threads();
+  int pass;
+
+  for (pass = 0; pass < PASSES; pass++) {
+    int src = pass & 1;
+    int dst = src ^ 1;
+    int shift = pass*RADIX_BITS;
+    size_t i;
+    int d;
+
+    for (d = 0; d < RADIX; d++)
+      counts[t][d] = 0;
+
+    for (i = lo; i < hi; i++)
+      counts[t][(keys[src][i] >> shift) & (RADIX-1)] += 1;
+
+    NBODY_OMP_BARRIER
+
+    NBODY_OMP_MASTER
+    {
+      size_t sum = 0;
+      int u;
+
+      for (d = 0; d < RADIX; d++) {
+	for (u = 0; u < threads; u++) {
+	  size_t c = counts[u][d];
+
+	  counts[u][d] = sum;
+	  sum += c;
+	}
+      }
+    }
+
+    NBODY_OMP_BARRIER
+
+    for (i = lo; i < hi; i++) {
+      size_t j = counts[t][(keys[src][i] >> shift) & (RADIX-1)]++;
+
+      keys[dst][j] = keys[src][i];
+      slots[dst][j] = slots[src][i];
+    }
+
+    NBODY_OMP_BARRIER
+  }
+}
+
+static void reorder_gather (size_t n, value * a) {
+  size_t i;
+
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++)
+    scratch[i] = a[slots[0][i]];
+
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++)
+    a[i] = scratch[i];
+}
+
+void reorder_free (void) {
+  free(bounds);
+  free(counts);
+
+  align_free(scratch_id);
+  align_free(scratch);
+
+  align_free(slots[1]);
+  align_free(slots[0]);
+  align_free(keys[1]);
+  align_free(keys[0]);
+}
+
+void reorder_init (size_t n) {
+  int threads = nbody_omp_max_threads();
+
+  keys[0] = align_malloc(ALIGN_BOUNDARY, n*sizeof(uint32_t));
+  keys[1] = align_malloc(ALIGN_BOUNDARY, n*sizeof(uint32_t));
+
+  slots[0] = align_malloc(ALIGN_BOUNDARY, n*sizeof(size_t));
+  slots[1] = align_malloc(ALIGN_BOUNDARY, n*sizeof(size_t));
+
+  scratch = align_malloc(ALIGN_BOUNDARY, n*sizeof(value));
+  scratch_id = align_malloc(ALIGN_BOUNDARY, n*sizeof(size_t));
+
+  counts = malloc(threads*sizeof(*counts));
+  bounds = malloc(threads*sizeof(*bounds));
+
+  if (keys[0] == NULL || keys[1] == NULL ||
+      slots[0] == NULL || slots[1] == NULL ||
+      scratch == NULL || scratch_id == NULL ||
+      counts == NULL || bounds == NULL) {
+    perror(__func__);
+    exit(EXIT_FAILURE);
+  }
+}
+
+void reorder_particles (size_t n, size_t * id,
+			value * px, value * py,
+			value * vx, value * vy,
+			value * m) {
+  int t = nbody_omp_thread();
+  int threads = nbody_omp_threads();
+  size_t lo = n*t/threads;
+  size_t hi = n*(t+1)/threads;
+  size_t i;
+
+  reorder_keys(lo, hi, px, py, m);
+
+  NBODY_OMP_BARRIER
+
+  reorder_sort(lo, hi);
+
+  physics_reorder(n, slots[0]);
+
+  reorder_gather(n, px);
+  reorder_gather(n, py);
+  reorder_gather(n, vx);
+  reorder_gather(n, vy);
+  reorder_gather(n, m);
+
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++)
+    scratch_id[i] = id[slots[0][i]];
+
+  NBODY_OMP_FOR
+  for (i = 0; i < n; i++)
+    id[i] = scratch_id[i];
+}
+
+size_t reorder_compact (size_t n, const unsigned char * keep,
+			size_t * id,
+			value * px, value * py,
+			value * vx, value * vy,
+			value * m) {
+  int t = nbody_omp_thread();
+  int threads = nbody_omp_threads();
+  size_t lo = n*t/threads;
+  size_t hi = n*(t+1)/threads;
+  size_t i, j, kept;
+  int u;
+
+  for (i = lo, j = 0; i < hi; i++)
+    j += keep[i] != 0;
+
+  counts[t][0] = j;
+
+  NBODY_OMP_BARRIER
+
+  /* the survivors of every range follow those of the ranges before
+     it, so the order does not depend on the number of threads */
+  for (u = 0, kept = 0; u < threads; u++) {
+    if (u == t)
+      counts[t][1] = kept;
+
+    kept += counts[u][0];
+  }
+
+  if (kept == n)
+    return n;
+
+  for (i = lo, j = counts[t][1]; i < hi; i++)
+    if (keep[i])
+      slots[0][j++] = i;
+
+  NBODY_OMP_BARRIER
+
+  physics_reorder(kept, slots[0]);
+
+  reorder_gather(kept, px);
+  reorder_gather(kept, py);
+  reorder_gather(kept, vx);
+  reorder_gather(kept, vy);
+  reorder_gather(kept, m);
+
+  NBODY_OMP_FOR
+  for (i = 0; i < kept; i++)
+    scratch_id[i] = id[slots[0][i]];
+
+  NBODY_OMP_FOR
+  for (i = 0; i < kept; i++)
+    id[i] = scratch_id[i];
+
+  /* the vector loops read past the last particle */
+  NBODY_OMP_FOR
+  for (i = kept; i < n; i++) {
+    px[i] = value_literal(0.0);
+    py[i] = value_literal(0.0);
+    vx[i] = value_literal(0.0);
+    vy[i] = value_literal(0.0);
+    m[i] = value_literal(0.0);
+  }
+
+  return kept;
+}
@@ -0,0 +1,39 @@
+#ifndef REORDER_H
+#define REORDER_H 1
+
+#include <stddef.h>
+#include "value.h"
+
+/* space filling curves */
+#define REORDER_MORTON  0
+#define REORDER_HILBERT 1
+
+#define REORDER_CURVE REORDER_HILBERT
+
+/* frees underlying resources */
+extern void reorder_free (void);
+
+/* initializes the reordering of n particles */
+extern void reorder_init (size_t n);
+
+/* sorts the particles along the space filling curve, massless ones
+   after all of the massive ones so that the force loops can stop at
+   the last massive particle. the ids are
+   permuted along with the particles so that id[i] keeps naming the
+   particle in slot i. must be called by every thread. */
+extern void reorder_particles (size_t n, size_t * id,
+			       value * px, value * py,
+			       value * vx, value * vy,
+			       value * m);
+
+/* removes the particles whose keep flag is 0, the others move down
+   in order to fill the gaps and the slots from the returned count on
+   are zeroed. physics_reorder is told about the move. must be called
+   by every thread. */
+extern size_t reorder_compact (size_t n, const unsigned char * keep,
+			       size_t * id,
+			       value * px, value * py,
+			       value * vx, value * vy,
+			       value * m);
+
+#endif /* REORDER_H */
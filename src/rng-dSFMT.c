@@ -17,6 +17,8 @@ static struct {
   double * end;
 } array;
 
+static unsigned long int seed = 0;
+
 static bool initialized = false;
 
 void rng_free (void) {
@@ -29,8 +31,12 @@ void rng_init (void) {
   if (initialized)
     return;
 
-  (void) gettimeofday(&timebuf, NULL);
-  dsfmt_gv_init_gen_rand(timebuf.tv_sec ^ timebuf.tv_usec);
+  if (seed == 0) {
+    (void) gettimeofday(&timebuf, NULL);
+    seed = timebuf.tv_sec ^ timebuf.tv_usec;
+  }
+
+  dsfmt_gv_init_gen_rand(seed);
 
   array.base = &storage[0];
   array.end  = &storage[STORAGE_SIZE-1];
@@ -39,6 +45,10 @@ void rng_init (void) {
   initialized = true;
 }
 
+void rng_seed (unsigned long int s) {
+  seed = s;
+}
+
 /*
  * Draws a uniformly distributed number
  * on the interval (0, 1].
@@ -68,3 +78,19 @@ double rng_normal (double std, double mean) {
 
   return std * y * sqrt(-2.0 * log(r2)/r2) + mean;
 }
+
+void rng_uniform_array (size_t n, value * out,
+			double lower, double upper) {
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    out[i] = rng_uniform(lower, upper);
+}
+
+void rng_normal_array (size_t n, value * out,
+		       double std, double mean) {
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    out[i] = rng_normal(std, mean);
+}
@@ -0,0 +1 @@
+LDLIBS += -ldSFMT
@@ -0,0 +1 @@
+rng-dSFMT.mk
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <sys/time.h>
+
+#include "nbody-openmp.h"
+#include "rng.h"
+
+/* Philox4x32-10 from Salmon et al., "Parallel Random Numbers: As
+   Easy as 1, 2, 3". Every number is a pure function of the key
+   (the seed) and a counter (stream, index), so any thread can
+   draw any element of any stream without shared state. */
+#define PHILOX_ROUNDS 10
+
+#define PHILOX_M0 UINT32_C(0xD2511F53)
+#define PHILOX_M1 UINT32_C(0xCD9E8D57)
+#define PHILOX_W0 UINT32_C(0x9E3779B9)
+#define PHILOX_W1 UINT32_C(0xBB67AE85)
+
+/* number of counters transformed together, large enough for the
+   compiler to vectorise the rounds and the Box-Muller transform */
+#define BLOCK_SIZE 16
+
+/* stream used by the scalar rng_uniform/rng_normal */
+#define SCALAR_STREAM 0
+
+static uint64_t seed = 0;
+static uint64_t key;
+
+static uint64_t scalar_counter;
+static uint64_t next_stream;
+
+static bool initialized = false;
+
+static inline void philox_round (uint32_t c[4], const uint32_t k[2]) {
+  uint64_t p0 = (uint64_t) PHILOX_M0 * c[0];
+  uint64_t p1 = (uint64_t) PHILOX_M1 * c[2];
+
+  uint32_t c1 = c[1];
+  uint32_t c3 = c[3];
+
+  c[0] = (uint32_t) (p1 >> 32) ^ c1 ^ k[0];
+  c[1] = (uint32_t) p1;
+  c[2] = (uint32_t) (p0 >> 32) ^ c3 ^ k[1];
+  c[3] = (uint32_t) p0;
+}
+
+static inline void philox (uint64_t stream, uint64_t index, uint32_t c[4]) {
+  uint32_t k[2];
+  int r;
+
+  c[0] = (uint32_t) index;
+  c[1] = (uint32_t) (index >> 32);
+  c[2] = (uint32_t) stream;
+  c[3] = (uint32_t) (stream >> 32);
+
+  k[0] = (uint32_t) key;
+  k[1] = (uint32_t) (key >> 32);
+
+  for (r = 0; r < PHILOX_ROUNDS; r++) {
+    philox_round(c, k);
+
+    k[0] += PHILOX_W0;
+    k[1] += PHILOX_W1;
+  }
+}
+
+/* maps 64 random bits to a double in (0, 1] */
+static inline double rng_bits_uniform (uint32_t hi, uint32_t lo) {
+  uint64_t u = ((uint64_t) hi << 32) | lo;
+
+  return ((u >> 11) + 1) * 0x1.0p-53;
+}
+
+void rng_free (void) {
+  return;
+}
+
+void rng_init (void) {
+  struct timeval timebuf;
+
+  if (initialized)
+    return;
+
+  if (seed == 0) {
+    (void) gettimeofday(&timebuf, NULL);
+    seed = timebuf.tv_sec ^ timebuf.tv_usec;
+  }
+
+  printf("rng seed %lu\n", (unsigned long int) seed);
+
+  key = seed;
+
+  scalar_counter = 0;
+  next_stream = SCALAR_STREAM + 1;
+
+  initialized = true;
+}
+
+void rng_seed (unsigned long int s) {
+  seed = s;
+}
+
+double rng_uniform (double lower, double upper) {
+  uint32_t c[4];
+
+  philox(SCALAR_STREAM, scalar_counter++, c);
+
+  return lower + (upper-lower)*rng_bits_uniform(c[0], c[1]);
+}
+
+double rng_normal (double std, double mean) {
+  uint32_t c[4];
+  double u1, u2;
+
+  philox(SCALAR_STREAM, scalar_counter++, c);
+
+  u1 = rng_bits_uniform(c[0], c[1]);
+  u2 = rng_bits_uniform(c[2], c[3]);
+
+  return std * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2) + mean;
+}
+
+/*
+ * Element i of a stream only depends on the seed, the stream
+ * and i, so work can be split between threads in any way and
+ * the result stays bit-identical.
+ */
+void rng_uniform_array (size_t n, value * out,
+			double lower, double upper) {
+  uint64_t stream = next_stream++;
+  size_t b;
+
+  NBODY_OMP_PARALLEL_FOR
+  for (b = 0; b < n; b += BLOCK_SIZE) {
+    uint32_t c[BLOCK_SIZE][4];
+    size_t i, len = n - b < BLOCK_SIZE ? n - b : BLOCK_SIZE;
+
+    for (i = 0; i < BLOCK_SIZE; i++)
+      philox(stream, b + i, c[i]);
+
+    for (i = 0; i < len; i++)
+      out[b + i] = lower + (upper-lower)*rng_bits_uniform(c[i][0], c[i][1]);
+  }
+}
+
+/*
+ * Box-Muller on blocks of counters, each counter yields the
+ * uniform pair for elements 2k and 2k+1.
+ */
+void rng_normal_array (size_t n, value * out,
+		       double std, double mean) {
+  uint64_t stream = next_stream++;
+  size_t b;
+
+  NBODY_OMP_PARALLEL_FOR
+  for (b = 0; b < n; b += 2*BLOCK_SIZE) {
+    uint32_t c[BLOCK_SIZE][4];
+    double z[2*BLOCK_SIZE];
+    size_t i, len = n - b < 2*BLOCK_SIZE ? n - b : 2*BLOCK_SIZE;
+
+    for (i = 0; i < BLOCK_SIZE; i++)
+      philox(stream, b/2 + i, c[i]);
+
+    for (i = 0; i < BLOCK_SIZE; i++) {
+      double u1 = rng_bits_uniform(c[i][0], c[i][1]);
+      double u2 = rng_bits_uniform(c[i][2], c[i][3]);
+
+      double r = std * sqrt(-2.0 * log(u1));
+
+      z[2*i+0] = r * cos(2.0 * M_PI * u2) + mean;
+      z[2*i+1] = r * sin(2.0 * M_PI * u2) + mean;
+    }
+
+    for (i = 0; i < len; i++)
+      out[b + i] = z[i];
+  }
+}
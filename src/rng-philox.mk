@@ -0,0 +1 @@
+# philox is self-contained, nothing to link against
@@ -1,16 +1,30 @@
 #ifndef RNG_H
 #define RNG_H 1
 
+#include <stddef.h>
+#include "value.h"
+
 /* frees underlying state */
 extern void rng_free (void);
 
 /* initializes the random number generator */
 extern void rng_init (void);
 
+/* sets the seed used by rng_init, 0 seeds from the clock */
+extern void rng_seed (unsigned long int seed);
+
 /* draws a uniformly distributed number in (lower, upper] */
 extern double rng_uniform (double lower, double upper);
 
 /* draws a normally distributed number */
 extern double rng_normal (double std, double mean);
 
+/* draws n uniformly distributed numbers in (lower, upper] */
+extern void rng_uniform_array (size_t n, value * out,
+			       double lower, double upper);
+
+/* draws n normally distributed numbers */
+extern void rng_normal_array (size_t n, value * out,
+			      double std, double mean);
+
 #endif /* RNG_H */
@@ -0,0 +1,78 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "physics.h"
+#include "rsqrt.h"
+#include "simd.h"
+
+/* particles whose pairs rsqrt_report looks at */
+#define RSQRT_SAMPLE 64
+
+int rsqrt_mode = RSQRT_ESTIMATE;
+
+static const char * const rsqrt_names[] = {
+  "estimate", "newton", "exact"
+};
+
+void rsqrt_init (int mode) {
+  const char * name = getenv("NBODY_RSQRT");
+  int i;
+
+  rsqrt_mode = mode;
+
+  if (name == NULL)
+    return;
+
+  for (i = RSQRT_ESTIMATE; i <= RSQRT_EXACT; i++)
+    if (strcmp(name, rsqrt_names[i]) == 0) {
+      rsqrt_mode = i;
+      return;
+    }
+
+  fprintf(stderr, "%s: NBODY_RSQRT must be estimate, newton or exact\n",
+	  __func__);
+  exit(EXIT_FAILURE);
+}
+
+void rsqrt_report (size_t n, const value * px, const value * py) {
+  double max = 0.0, sum = 0.0;
+  size_t pairs = 0;
+  size_t i, j, l;
+
+  /* at the width of the kernels, the AVX-512 estimate is better */
+  for (i = 0; i < n && i < RSQRT_SAMPLE; i++)
+    for (j = 0; j < n; j += SIMD_WIDTH) {
+      value s[SIMD_WIDTH], y[SIMD_WIDTH];
+
+      for (l = 0; l < SIMD_WIDTH; l++) {
+	value rx = j + l < n ? px[j + l] - px[i] : value_literal(0.0);
+	value ry = j + l < n ? py[j + l] - py[i] : value_literal(0.0);
+	value s0 = (rx*rx + ry*ry) + SOFTENING*SOFTENING;
+
+	s[l] = s0*s0*s0;
+      }
+
+      simd_storeu(y, simd_rsqrt(simd_loadu(s), rsqrt_mode));
+
+      for (l = 0; l < SIMD_WIDTH && j + l < n; l++) {
+	double e;
+
+	if (j + l == i)
+	  continue;
+
+	e = fabs(y[l]*sqrt((double) s[l]) - 1.0);
+
+	if (e > max)
+	  max = e;
+
+	sum += e*e;
+	pairs += 1;
+      }
+    }
+
+  printf("rsqrt %s, pair force error max %.3g rms %.3g\n",
+	 rsqrt_names[rsqrt_mode], max,
+	 pairs > 0 ? sqrt(sum/pairs) : 0.0);
+}
@@ -0,0 +1,83 @@
+#ifndef RSQRT_H
+#define RSQRT_H 1
+
+#include <stddef.h>
+#include <immintrin.h>
+
+#include "value.h"
+
+/* how the simd kernels take the reciprocal square root of a pair */
+#define RSQRT_ESTIMATE 0    /* the hardware estimate, about 12 bits */
+#define RSQRT_NEWTON   1    /* one newton step on it, about 22 bits */
+#define RSQRT_EXACT    2    /* a square root and a division */
+
+/* the mode chosen by rsqrt_init, read by the kernels */
+extern int rsqrt_mode;
+
+/* chooses the mode from NBODY_RSQRT in the environment, one of
+   estimate, newton or exact, falling back to mode when it is not
+   set */
+extern void rsqrt_init (int mode);
+
+/* prints the mode along with the largest and the rms relative error
+   it makes in the pull between particles, over every pair with one
+   of the first few particles */
+extern void rsqrt_report (size_t n, const value * px, const value * py);
+
+static inline __m128 rsqrt_sse (__m128 s, int mode) {
+  __m128 y;
+
+  if (mode == RSQRT_EXACT)
+    return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(s));
+
+  y = _mm_rsqrt_ps(s);
+
+  /* y (3 - s y^2)/2 */
+  if (mode == RSQRT_NEWTON)
+    y = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), y),
+		   _mm_sub_ps(_mm_set1_ps(3.0f),
+			      _mm_mul_ps(s, _mm_mul_ps(y, y))));
+
+  return y;
+}
+
+#ifdef __AVX__
+static inline __m256 rsqrt_avx (__m256 s, int mode) {
+  __m256 y;
+
+  if (mode == RSQRT_EXACT)
+    return _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(s));
+
+  y = _mm256_rsqrt_ps(s);
+
+  /* y (3 - s y^2)/2 */
+  if (mode == RSQRT_NEWTON)
+    y = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), y),
+		      _mm256_sub_ps(_mm256_set1_ps(3.0f),
+				    _mm256_mul_ps(s, _mm256_mul_ps(y, y))));
+
+  return y;
+}
+#endif /* __AVX__ */
+
+/* the AVX-512 estimate is good to 14 bits */
+#ifdef __AVX512F__
+static inline __m512 rsqrt_avx512 (__m512 s, int mode) {
+  __m512 y;
+
+  if (mode == RSQRT_EXACT)
+    return _mm512_div_ps(_mm512_set1_ps(1.0f), _mm512_sqrt_ps(s));
+
+  y = _mm512_rsqrt14_ps(s);
+
+  /* y (3 - s y^2)/2 */
+  if (mode == RSQRT_NEWTON)
+    y = _mm512_mul_ps(_mm512_mul_ps(_mm512_set1_ps(0.5f), y),
+		      _mm512_sub_ps(_mm512_set1_ps(3.0f),
+				    _mm512_mul_ps(s, _mm512_mul_ps(y, y))));
+
+  return y;
+}
+#endif /* __AVX512F__ */
+
+#endif /* RSQRT_H */
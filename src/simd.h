@@ -0,0 +1,76 @@
+#ifndef SIMD_H
+#define SIMD_H 1
+
+#include <immintrin.h>
+
+#include "rsqrt.h"
+#include "value.h"
+
+/*
+ * A thin layer over the single precision vectors of one instruction
+ * set, so that a kernel written against it once is compiled for
+ * every width. The .mk of a backend picks the width with SIMD_WIDTH,
+ * 4 for SSE, 8 for AVX and 16 for AVX-512, along with the -m flag
+ * and an ALIGN_BOUNDARY and ALLOC_PADDING of at least a vector.
+ *
+ * Loads and stores are aligned unless they end in u, simd_broadcast
+ * repeats one value from memory in every lane and simd_rsqrt is the
+ * reciprocal square root in one of the modes of rsqrt.h.
+ */
+#ifndef SIMD_WIDTH
+#define SIMD_WIDTH 4
+#endif
+
+#if SIMD_WIDTH == 4
+typedef __m128 simd;
+
+#define simd_load(p) _mm_load_ps((p))
+#define simd_loadu(p) _mm_loadu_ps((p))
+#define simd_store(p, a) _mm_store_ps((p), (a))
+#define simd_storeu(p, a) _mm_storeu_ps((p), (a))
+#define simd_set1(a) _mm_set1_ps((a))
+#define simd_broadcast(p) _mm_load1_ps((p))
+#define simd_zero() _mm_setzero_ps()
+
+#define simd_add(a, b) _mm_add_ps((a), (b))
+#define simd_sub(a, b) _mm_sub_ps((a), (b))
+#define simd_mul(a, b) _mm_mul_ps((a), (b))
+
+#define simd_rsqrt(s, mode) rsqrt_sse((s), (mode))
+#elif SIMD_WIDTH == 8
+typedef __m256 simd;
+
+#define simd_load(p) _mm256_load_ps((p))
+#define simd_loadu(p) _mm256_loadu_ps((p))
+#define simd_store(p, a) _mm256_store_ps((p), (a))
+#define simd_storeu(p, a) _mm256_storeu_ps((p), (a))
+#define simd_set1(a) _mm256_set1_ps((a))
+#define simd_broadcast(p) _mm256_broadcast_ss((p))
+#define simd_zero() _mm256_setzero_ps()
+
+#define simd_add(a, b) _mm256_add_ps((a), (b))
+#define simd_sub(a, b) _mm256_sub_ps((a), (b))
+#define simd_mul(a, b) _mm256_mul_ps((a), (b))
+
+#define simd_rsqrt(s, mode) rsqrt_avx((s), (mode))
+#elif SIMD_WIDTH == 16
+typedef __m512 simd;
+
+#define simd_load(p) _mm512_load_ps((p))
+#define simd_loadu(p) _mm512_loadu_ps((p))
+#define simd_store(p, a) _mm512_store_ps((p), (a))
+#define simd_storeu(p, a) _mm512_storeu_ps((p), (a))
+#define simd_set1(a) _mm512_set1_ps((a))
+#define simd_broadcast(p) _mm512_set1_ps(*(p))
+#define simd_zero() _mm512_setzero_ps()
+
+#define simd_add(a, b) _mm512_add_ps((a), (b))
+#define simd_sub(a, b) _mm512_sub_ps((a), (b))
+#define simd_mul(a, b) _mm512_mul_ps((a), (b))
+
+#define simd_rsqrt(s, mode) rsqrt_avx512((s), (mode))
+#else
+#error SIMD_WIDTH must be 4, 8 or 16
+#endif
+
+#endif /* SIMD_H */
@@ -0,0 +1,271 @@
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <dirent.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nbody-openmp.h"
+#include "topology.h"
+#include "value.h"
+
+#define TOPOLOGY_SYSFS "/sys/devices/system/cpu"
+
+struct topology_cpu {
+  int cpu;
+  int node;
+  int package;
+  int core;
+  int smt;      /* index among the hardware threads of its core */
+};
+
+static struct topology_cpu * cpus = NULL;
+static int cpus_n;
+
+/* cpu each thread of the team runs on, -1 when not pinned */
+static int * pinned = NULL;
+static int threads_n;
+
+static int topology_read (int cpu, const char * name, int fallback) {
+  char path[256];
+  FILE * f;
+  int r;
+
+  snprintf(path, sizeof(path), TOPOLOGY_SYSFS "/cpu%d/%s", cpu, name);
+
+  f = fopen(path, "r");
+
+  if (f == NULL)
+    return fallback;
+
+  if (fscanf(f, "%d", &r) != 1)
+    r = fallback;
+
+  fclose(f);
+
+  return r;
+}
+
+/* the cpu directory holds a nodeN link on numa systems */
+static int topology_node (int cpu, int fallback) {
+  char path[256];
+  struct dirent * e;
+  DIR * d;
+  int r = fallback;
+
+  snprintf(path, sizeof(path), TOPOLOGY_SYSFS "/cpu%d", cpu);
+
+  d = opendir(path);
+
+  if (d == NULL)
+    return fallback;
+
+  while ((e = readdir(d)) != NULL) {
+    if (strncmp(e->d_name, "node", 4) == 0 && isdigit(e->d_name[4])) {
+      r = atoi(e->d_name + 4);
+      break;
+    }
+  }
+
+  closedir(d);
+
+  return r;
+}
+
+/* by node, then cores before their second hardware threads */
+static int topology_compare (const void * a, const void * b) {
+  const struct topology_cpu * x = a;
+  const struct topology_cpu * y = b;
+
+  if (x->node != y->node)
+    return x->node - y->node;
+  if (x->smt != y->smt)
+    return x->smt - y->smt;
+  if (x->package != y->package)
+    return x->package - y->package;
+  if (x->core != y->core)
+    return x->core - y->core;
+
+  return x->cpu - y->cpu;
+}
+
+static int topology_nodes (void) {
+  int i, r = 0;
+
+  for (i = 0; i < cpus_n; i++)
+    if (i == 0 || cpus[i].node != cpus[i-1].node)
+      r += 1;
+
+  return r;
+}
+
+/* first thread of the g:th node, earlier nodes take the remainder */
+static inline int topology_start (int g, int threads, int nodes) {
+  return (threads*g + nodes-1)/nodes;
+}
+
+/* cpu the t:th of threads threads runs on, threads are handed to
+   the nodes in contiguous ranges of as equal size as possible */
+static const struct topology_cpu * topology_cpu (int t, int threads) {
+  int nodes = topology_nodes();
+  int g = 0, first = 0, i, k;
+
+  while (topology_start(g+1, threads, nodes) <= t)
+    g += 1;
+
+  k = t - topology_start(g, threads, nodes);
+
+  /* skip to the g:th node */
+  for (i = 1; i < cpus_n && g > 0; i++) {
+    if (cpus[i].node != cpus[i-1].node) {
+      first = i;
+      g -= 1;
+    }
+  }
+
+  for (i = first; i < cpus_n && cpus[i].node == cpus[first].node; i++)
+    ;
+
+  return &cpus[first + k % (i - first)];
+}
+
+static void topology_scan (void) {
+  cpu_set_t allowed;
+  int c, i;
+
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+    perror(__func__);
+    exit(EXIT_FAILURE);
+  }
+
+  cpus = malloc(CPU_COUNT(&allowed)*sizeof(*cpus));
+
+  if (cpus == NULL) {
+    perror(__func__);
+    exit(EXIT_FAILURE);
+  }
+
+  cpus_n = 0;
+
+  for (c = 0; c < CPU_SETSIZE; c++) {
+    struct topology_cpu * p;
+
+    if (!CPU_ISSET(c, &allowed))
+      continue;
+
+    p = &cpus[cpus_n++];
+
+    p->cpu     = c;
+    p->package = topology_read(c, "topology/physical_package_id", 0);
+    p->core    = topology_read(c, "topology/core_id", c);
+    p->node    = topology_node(c, p->package);
+    p->smt     = 0;
+
+    for (i = 0; i < cpus_n-1; i++)
+      if (cpus[i].package == p->package && cpus[i].core == p->core)
+	p->smt += 1;
+  }
+
+  qsort(cpus, cpus_n, sizeof(*cpus), topology_compare);
+}
+
+static void topology_report (void) {
+  int i, t, packages = 0, cores = 0;
+
+  for (i = 0; i < cpus_n; i++) {
+    int j;
+
+    if (cpus[i].smt == 0)
+      cores += 1;
+
+    for (j = 0; j < i && cpus[j].package != cpus[i].package; j++)
+      ;
+
+    if (j == i)
+      packages += 1;
+  }
+
+  printf("topology %d nodes, %d packages, %d cores, %d cpus\n",
+	 topology_nodes(), packages, cores, cpus_n);
+
+  if (pinned[0] < 0) {
+    printf("%d threads, not pinned\n", threads_n);
+    return;
+  }
+
+  for (t = 0; t < threads_n; t++) {
+    const struct topology_cpu * p = topology_cpu(t, threads_n);
+
+    printf("thread %d cpu %d node %d package %d core %d%s\n",
+	   t, pinned[t], p->node, p->package, p->core,
+	   p->smt > 0 ? " (smt)" : "");
+  }
+}
+
+void topology_free (void) {
+  free(pinned);
+  free(cpus);
+
+  pinned = NULL;
+  cpus = NULL;
+}
+
+void topology_init (void) {
+  int bind;
+
+  topology_scan();
+
+  threads_n = nbody_omp_max_threads();
+  pinned = malloc(threads_n*sizeof(*pinned));
+
+  if (pinned == NULL) {
+    perror(__func__);
+    exit(EXIT_FAILURE);
+  }
+
+  /* the user asked the runtime to do it */
+  bind = getenv("OMP_PROC_BIND") == NULL && getenv("OMP_PLACES") == NULL;
+
+#ifndef _OPENMP
+  /* a single thread is better left to the scheduler */
+  bind = 0;
+#endif
+
+  /* the runtime keeps the threads of a team alive between parallel
+     regions, so each team member stays where it is put here */
+  NBODY_OMP_PARALLEL
+  {
+    int t = nbody_omp_thread();
+    cpu_set_t set;
+
+    pinned[t] = -1;
+
+    if (bind) {
+      pinned[t] = topology_cpu(t, nbody_omp_threads())->cpu;
+
+      CPU_ZERO(&set);
+      CPU_SET(pinned[t], &set);
+
+      if (sched_setaffinity(0, sizeof(set), &set) < 0)
+	pinned[t] = -1;
+    }
+  }
+
+  topology_report();
+}
+
+void topology_place (void * ptr, size_t size) {
+  value * p = ptr;
+  size_t k = size/sizeof(value);
+  size_t i;
+
+  /* pages are placed whole, with huge pages a thread may share its
+     first and last page with its neighbours */
+  NBODY_OMP_PARALLEL_FOR
+  for (i = 0; i < k; i++)
+    p[i] = 0;
+
+  memset(p + k, 0, size - k*sizeof(value));
+}
@@ -0,0 +1,23 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H 1
+
+#include <stddef.h>
+
+/* frees underlying resources */
+extern void topology_free (void);
+
+/* reads the processor topology, pins every thread of the team the
+   main loop will run with to its own cpu and prints what was used.
+   threads are spread evenly over the numa nodes, consecutive
+   threads share a node and a physical core is only given a second
+   thread once every core of its node has one. nothing is pinned
+   when OMP_PROC_BIND or OMP_PLACES is set. */
+extern void topology_init (void);
+
+/* touches size bytes at ptr from the threads that will later work
+   on them, following the schedule NBODY_OMP_FOR uses over arrays
+   of values, so that their pages land on the node of that thread.
+   fits align_arena_placement. */
+extern void topology_place (void * ptr, size_t size);
+
+#endif /* TOPOLOGY_H */
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tune.h"
+
+/* longest line of the cache and of a cpu model */
+#define TUNE_LINE  512
+#define TUNE_MODEL 256
+#define TUNE_PATH  4096
+
+/* the file the cache lives in, 0 when there is none */
+static int tune_path (char * path) {
+  const char * file = getenv("NBODY_TUNE_CACHE");
+  const char * home = getenv("HOME");
+
+  if (file != NULL)
+    return snprintf(path, TUNE_PATH, "%s", file) < TUNE_PATH;
+
+  if (home == NULL)
+    return 0;
+
+  return snprintf(path, TUNE_PATH, "%s/%s", home, TUNE_CACHE) < TUNE_PATH;
+}
+
+/* the model name of the first cpu */
+static void tune_model (char * model) {
+  char line[TUNE_LINE];
+  FILE * f = fopen("/proc/cpuinfo", "r");
+
+  strcpy(model, "unknown");
+
+  if (f == NULL)
+    return;
+
+  while (fgets(line, sizeof(line), f) != NULL)
+    if (strncmp(line, "model name", 10) == 0) {
+      char * name = strchr(line, ':');
+
+      if (name != NULL && sscanf(name + 1, " %255[^\n]", model) == 1)
+	break;
+    }
+
+  fclose(f);
+}
+
+/* runs tuned for n particles are good for every n up to the next
+   power of two */
+static size_t tune_bucket (size_t n) {
+  size_t bucket = 1;
+
+  while (bucket < n)
+    bucket *= 2;
+
+  return bucket;
+}
+
+/* parses a line of the cache, returns 1 if it is well formed */
+static int tune_parse (const char * line, char * kernel, size_t * bucket,
+		       struct tune * t, char * model) {
+  return sscanf(line, "%63s %zu %zu %u %d %255[^\n]",
+		kernel, bucket, &t->tile, &t->block, &t->threads,
+		model) == 6;
+}
+
+int tune_mode (void) {
+  const char * mode = getenv("NBODY_TUNE");
+
+  if (mode == NULL)
+    return TUNE_CACHED;
+
+  if (strcmp(mode, "off") == 0)
+    return TUNE_OFF;
+
+  if (strcmp(mode, "again") == 0)
+    return TUNE_AGAIN;
+
+  fprintf(stderr, "%s: NBODY_TUNE must be off or again\n", __func__);
+  exit(EXIT_FAILURE);
+}
+
+int tune_load (const char * kernel, size_t n, struct tune * t) {
+  char path[TUNE_PATH];
+  char model[TUNE_MODEL];
+  char line[TUNE_LINE];
+  int found = 0;
+  FILE * f;
+
+  if (!tune_path(path) || (f = fopen(path, "r")) == NULL)
+    return 0;
+
+  tune_model(model);
+
+  while (!found && fgets(line, sizeof(line), f) != NULL) {
+    char k[64], m[TUNE_MODEL];
+    size_t bucket;
+    struct tune c;
+
+    if (tune_parse(line, k, &bucket, &c, m) &&
+	strcmp(k, kernel) == 0 && bucket == tune_bucket(n) &&
+	strcmp(m, model) == 0 &&
+	c.block > 0 && c.block <= TUNE_BLOCK_MAX &&
+	(c.block & (c.block - 1)) == 0 && c.threads > 0) {
+      *t = c;
+      found = 1;
+    }
+  }
+
+  fclose(f);
+
+  return found;
+}
+
+void tune_save (const char * kernel, size_t n, const struct tune * t) {
+  char path[TUNE_PATH], temp[TUNE_PATH + 8];
+  char model[TUNE_MODEL];
+  char line[TUNE_LINE];
+  FILE * f;
+  FILE * g;
+  int fd;
+
+  if (!tune_path(path))
+    return;
+
+  tune_model(model);
+
+  /* the other entries are copied over, then the file is replaced
+     in one go so that runs starting at the same time read either */
+  snprintf(temp, sizeof(temp), "%s.XXXXXX", path);
+
+  /* a name of its own, runs tuning at the same time would otherwise
+     write to the same file and one could rename the other's half of
+     it into place */
+  fd = mkstemp(temp);
+
+  if (fd < 0) {
+    perror(__func__);
+    return;
+  }
+
+  g = fdopen(fd, "w");
+
+  if (g == NULL) {
+    perror(__func__);
+    close(fd);
+    remove(temp);
+    return;
+  }
+
+  f = fopen(path, "r");
+
+  if (f != NULL) {
+    while (fgets(line, sizeof(line), f) != NULL) {
+      char k[64], m[TUNE_MODEL];
+      size_t bucket;
+      struct tune c;
+
+      if (!tune_parse(line, k, &bucket, &c, m) ||
+	  (strcmp(k, kernel) == 0 && bucket == tune_bucket(n) &&
+	   strcmp(m, model) == 0))
+	continue;
+
+      fputs(line, g);
+    }
+
+    fclose(f);
+  }
+
+  fprintf(g, "%s %zu %zu %u %d %s\n", kernel, tune_bucket(n),
+	  t->tile, t->block, t->threads, model);
+
+  if (fclose(g) != 0 || rename(temp, path) != 0) {
+    perror(__func__);
+    remove(temp);
+  }
+}
+
+double tune_timer (void) {
+  struct timespec now;
+
+  (void) clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec + 1e-9*now.tv_nsec;
+}
@@ -0,0 +1,50 @@
+#ifndef TUNE_H
+#define TUNE_H 1
+
+#include <stddef.h>
+
+/*
+ * The autotuner times a kernel on a sample of particles for every
+ * candidate configuration at startup and keeps the fastest. The
+ * choice is cached in a file, one line per kernel, bucket of n and
+ * cpu model, so that later runs on the same machine start tuned.
+ *
+ * NBODY_TUNE in the environment is off to run untuned, again to
+ * measure even when the cache has an entry, and unset otherwise.
+ * NBODY_TUNE_CACHE names the cache file, which is TUNE_CACHE in the
+ * home directory by default. Kernels measuring with a thread count
+ * that was asked for do not save what they find.
+ */
+#define TUNE_CACHE ".nbody-tune"
+
+/* most blocks any kernel takes, entries of the cache with more or
+   with a block that is not a power of two are ignored */
+#define TUNE_BLOCK_MAX 4
+
+#define TUNE_OFF    0
+#define TUNE_CACHED 1
+#define TUNE_AGAIN  2
+
+/* a configuration of a brute force kernel */
+struct tune {
+  size_t tile;            /* particles j per tile, 0 is all of them */
+  unsigned int block;     /* blocks of particles i sharing every j */
+  int threads;            /* threads of the main loop */
+};
+
+/* one of the modes above, from NBODY_TUNE */
+extern int tune_mode (void);
+
+/* looks up the configuration of kernel for n particles on this
+   machine, returns 1 and fills in t if there is one */
+extern int tune_load (const char * kernel, size_t n, struct tune * t);
+
+/* stores the configuration of kernel for n particles on this
+   machine, replacing any earlier one */
+extern void tune_save (const char * kernel, size_t n,
+		       const struct tune * t);
+
+/* seconds from an arbitrary start, for timing the candidates */
+extern double tune_timer (void);
+
+#endif /* TUNE_H */